@@ -0,0 +1,213 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include "replay.h"
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define BINDINGS_SSE2
+#endif
+
+enum SDLAxis {
+    SDL_AXIS_NULL,
+    SDL_AXIS_LEFT_LEFT,
+    SDL_AXIS_LEFT_RIGHT,
+    SDL_AXIS_LEFT_UP,
+    SDL_AXIS_LEFT_DOWN,
+    SDL_AXIS_RIGHT_LEFT,
+    SDL_AXIS_RIGHT_RIGHT,
+    SDL_AXIS_RIGHT_UP,
+    SDL_AXIS_RIGHT_DOWN,
+    SDL_AXIS_LTRIGGER_DOWN,
+    SDL_AXIS_RTRIGGER_DOWN,
+    SDL_AXIS_MAX
+};
+
+/* Normalized value of every SDLAxis direction, indexed by the enum. SDL_AXIS_NULL stays 0. */
+struct SDLAxisState {
+    float values[SDL_AXIS_MAX];
+};
+
+enum Scroll { MOUSE_SCROLL_INVALID, MOUSE_SCROLL_UP, MOUSE_SCROLL_DOWN };
+
+// Controllers get a player slot when connected, bindings can be limited to one slot
+constexpr uint8_t MaxControllers = InputSnapshot::Controllers;
+constexpr int AnySlot            = -1;
+
+/* Keybindings flattened into word-wide masks per controller slot, rebuilt by CompileBindings. */
+struct CompiledBindings {
+    uint64_t keyboard[4];
+    uint32_t buttons[MaxControllers];
+    uint32_t scroll;
+    uint8_t axisCount;
+    struct {
+        SDLAxis axis;
+        uint8_t slots;
+    } axis[SDL_AXIS_MAX];
+};
+
+struct InternalButtonState {
+    float Down;
+    bool Released;
+    bool Tapped;
+};
+
+// All digital inputs packed as bitsets, tapped and released edges are derived once per poll
+struct alignas (16) InputBits {
+    uint64_t keyboard[4];
+    uint64_t buttons[MaxControllers];
+    uint64_t scroll;
+    uint64_t reserved; // Keeps the size a multiple of 16 for the SSE2 edge pass
+};
+static_assert (sizeof (InputBits) % 16 == 0);
+
+/* Input of the current and the previous poll, the state every binding is evaluated against. */
+struct InputState {
+    InputBits current, last, tapped, released;
+    std::array<SDLAxisState, MaxControllers> axis, lastAxis;
+};
+
+// The current input becomes the last one, the scroll wheel only counts for the poll it was turned in
+inline void
+BeginInputFrame (InputState &state) {
+    state.last           = state.current;
+    state.lastAxis       = state.axis;
+    state.current.scroll = 0;
+}
+
+inline void
+UpdateInputEdges (InputState &state) {
+#ifdef BINDINGS_SSE2
+    const auto current  = reinterpret_cast<const __m128i *> (&state.current);
+    const auto last     = reinterpret_cast<const __m128i *> (&state.last);
+    const auto tapped   = reinterpret_cast<__m128i *> (&state.tapped);
+    const auto released = reinterpret_cast<__m128i *> (&state.released);
+    for (size_t i = 0; i < sizeof (InputBits) / sizeof (__m128i); i++) {
+        const __m128i cur = _mm_load_si128 (current + i);
+        const __m128i old = _mm_load_si128 (last + i);
+        _mm_store_si128 (tapped + i, _mm_andnot_si128 (old, cur));
+        _mm_store_si128 (released + i, _mm_andnot_si128 (cur, old));
+    }
+#else
+    const auto current  = reinterpret_cast<const uint64_t *> (&state.current);
+    const auto last     = reinterpret_cast<const uint64_t *> (&state.last);
+    const auto tapped   = reinterpret_cast<uint64_t *> (&state.tapped);
+    const auto released = reinterpret_cast<uint64_t *> (&state.released);
+    for (size_t i = 0; i < sizeof (InputBits) / sizeof (uint64_t); i++) {
+        tapped[i]   = current[i] & ~last[i];
+        released[i] = ~current[i] & last[i];
+    }
+#endif
+}
+
+// Recordings keep the axis values without the SDL_AXIS_NULL entry
+static_assert (sizeof (InputSnapshot::axis[0]) == sizeof (float) * (SDL_AXIS_MAX - 1));
+
+inline void
+SaveSnapshot (const InputState &state, InputSnapshot &snapshot) {
+    memcpy (snapshot.keyboard, state.current.keyboard, sizeof (snapshot.keyboard));
+    memcpy (snapshot.buttons, state.current.buttons, sizeof (snapshot.buttons));
+    snapshot.scroll = state.current.scroll;
+    for (uint8_t slot = 0; slot < MaxControllers; slot++)
+        memcpy (snapshot.axis[slot], state.axis[slot].values + 1, sizeof (snapshot.axis[slot]));
+}
+
+// Stands in for a poll, the recorded frame becomes the current input
+inline void
+LoadSnapshot (InputState &state, const InputSnapshot &snapshot) {
+    BeginInputFrame (state);
+    memcpy (state.current.keyboard, snapshot.keyboard, sizeof (snapshot.keyboard));
+    memcpy (state.current.buttons, snapshot.buttons, sizeof (snapshot.buttons));
+    state.current.scroll = snapshot.scroll;
+    for (uint8_t slot = 0; slot < MaxControllers; slot++)
+        memcpy (state.axis[slot].values + 1, snapshot.axis[slot], sizeof (snapshot.axis[slot]));
+    UpdateInputEdges (state);
+}
+
+// Without a slot, the strongest value across all controllers
+inline float
+AxisValue (const std::array<SDLAxisState, MaxControllers> &state, const SDLAxis axis, const int slot) {
+    if (axis <= SDL_AXIS_NULL || axis >= SDL_AXIS_MAX) return 0;
+    if (slot != AnySlot) return slot < MaxControllers ? state[slot].values[axis] : 0;
+    float value = 0;
+    for (const auto &controller : state)
+        value = std::max (value, controller.values[axis]);
+    return value;
+}
+
+// Slot 0 binds every controller, otherwise only the 1-based slot
+inline uint8_t
+BindingSlotMask (const uint8_t slot) {
+    return slot == 0 ? (1u << MaxControllers) - 1 : slot <= MaxControllers ? 1u << (slot - 1) : 0;
+}
+
+/* *
+ * Flattens the keycodes, buttons, axis and scroll arrays of a binding into masks.
+ * Buttons outside [0, buttonCount) are unbound, buttonCount is SDL_CONTROLLER_BUTTON_MAX in the game.
+ */
+template <typename Bindings>
+CompiledBindings
+CompileBindings (const Bindings &bindings, const int buttonCount) {
+    CompiledBindings compiled = {};
+
+    for (const uint8_t keycode : bindings.keycodes)
+        if (keycode != 0) compiled.keyboard[keycode / 64] |= 1ull << (keycode % 64);
+    for (size_t i = 0; i < std::size (bindings.buttons); i++) {
+        const int button = bindings.buttons[i];
+        if (button < 0 || button >= buttonCount) continue;
+        for (uint8_t slots = BindingSlotMask (bindings.buttonSlots[i]), slot = 0; slot < MaxControllers; slot++)
+            if (slots & (1u << slot)) compiled.buttons[slot] |= 1u << button;
+    }
+    for (size_t i = 0; i < std::size (bindings.axis); i++) {
+        const SDLAxis axis = bindings.axis[i];
+        if (axis <= SDL_AXIS_NULL || axis >= SDL_AXIS_MAX) continue;
+        const auto entry = std::find_if (compiled.axis, compiled.axis + compiled.axisCount, [&] (const auto &entry) { return entry.axis == axis; });
+        if (entry == compiled.axis + compiled.axisCount) compiled.axis[compiled.axisCount++] = {axis, BindingSlotMask (bindings.axisSlots[i])};
+        else entry->slots |= BindingSlotMask (bindings.axisSlots[i]);
+    }
+    for (const Scroll scroll : bindings.scroll)
+        if (scroll == MOUSE_SCROLL_UP || scroll == MOUSE_SCROLL_DOWN) compiled.scroll |= 1u << scroll;
+    return compiled;
+}
+
+// Any bound input down, tapped or released counts, an axis reports its value as Down
+inline InternalButtonState
+EvaluateBindings (const CompiledBindings &compiled, const InputState &state) {
+    InternalButtonState buttons = {};
+
+    uint64_t down = 0, tapped = 0, released = 0;
+    for (uint8_t slot = 0; slot < MaxControllers; slot++) {
+        down |= compiled.buttons[slot] & state.current.buttons[slot];
+        tapped |= compiled.buttons[slot] & state.tapped.buttons[slot];
+        released |= compiled.buttons[slot] & state.released.buttons[slot];
+    }
+    for (size_t i = 0; i < std::size (compiled.keyboard); i++) {
+        down |= compiled.keyboard[i] & state.current.keyboard[i];
+        tapped |= compiled.keyboard[i] & state.tapped.keyboard[i];
+        released |= compiled.keyboard[i] & state.released.keyboard[i];
+    }
+    if (down) buttons.Down = 1;
+    buttons.Tapped   = tapped != 0;
+    buttons.Released = released != 0;
+
+    for (uint8_t i = 0; i < compiled.axisCount; i++) {
+        const auto &[axis, slots] = compiled.axis[i];
+        for (uint8_t slot = 0; slot < MaxControllers; slot++) {
+            if (!(slots & (1u << slot))) continue;
+            const float value = state.axis[slot].values[axis];
+            const float last  = state.lastAxis[slot].values[axis];
+            if (!value && last) buttons.Released = true;
+            if (value) buttons.Down = value;
+            if (value && !last) buttons.Tapped = true;
+        }
+    }
+
+    if (compiled.scroll & state.current.scroll) buttons.Down = 1;
+    if (compiled.scroll & state.tapped.scroll) buttons.Tapped = true;
+    if (compiled.scroll & state.released.scroll) buttons.Released = true;
+
+    return buttons;
+}
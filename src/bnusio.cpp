@@ -1,9 +1,15 @@
-#include <queue>
+#include <algorithm>
 #include "constants.h"
 #include "helpers.h"
 #include "patches/patches.h"
 #include "bnusio.h"
+#include "drum.h"
+#include "eventbus.h"
+#include "histogram.h"
 #include "poll.h"
+#include "sampler.h"
+#include "scheduler.h"
+#include "usio.h"
 
 extern GameVersion gameVersion;
 extern std::vector<HMODULE> plugins;
@@ -17,6 +23,8 @@ extern bool autoIme;
 extern bool emulateUsio;
 extern bool emulateCardReader;
 extern bool acceptInvalidCards;
+extern std::string profileCsv;
+extern u32 profileInterval;
 
 typedef i32 (*callbackAttach) (i32, i32, i32 *);
 typedef void (*callbackTouch) (i32, i32, u8[168], u64);
@@ -48,6 +56,56 @@ Keybindings P2_LEFT_RED   = {.keycodes = {'X'}};
 Keybindings P2_RIGHT_RED  = {.keycodes = {'C'}};
 Keybindings P2_RIGHT_BLUE = {.keycodes = {'V'}};
 
+// Bit index of each binding in the LogicalInputFrame, in the order of namedBindings
+enum NamedBinding : u8 {
+    BINDING_EXIT,
+    BINDING_TEST,
+    BINDING_SERVICE,
+    BINDING_DEBUG_UP,
+    BINDING_DEBUG_DOWN,
+    BINDING_DEBUG_ENTER,
+    BINDING_COIN_ADD,
+    BINDING_CARD_INSERT_1,
+    BINDING_CARD_INSERT_2,
+    BINDING_QR_DATA_READ,
+    BINDING_QR_IMAGE_READ,
+    BINDING_P1_LEFT_BLUE,
+    BINDING_P1_LEFT_RED,
+    BINDING_P1_RIGHT_RED,
+    BINDING_P1_RIGHT_BLUE,
+    BINDING_P2_LEFT_BLUE,
+    BINDING_P2_LEFT_RED,
+    BINDING_P2_RIGHT_RED,
+    BINDING_P2_RIGHT_BLUE,
+    BINDING_COUNT
+};
+
+struct {
+    const char *name;
+    Keybindings *binding;
+} namedBindings[] = {
+    {"EXIT", &EXIT},
+    {"TEST", &TEST},
+    {"SERVICE", &SERVICE},
+    {"DEBUG_UP", &DEBUG_UP},
+    {"DEBUG_DOWN", &DEBUG_DOWN},
+    {"DEBUG_ENTER", &DEBUG_ENTER},
+    {"COIN_ADD", &COIN_ADD},
+    {"CARD_INSERT_1", &CARD_INSERT_1},
+    {"CARD_INSERT_2", &CARD_INSERT_2},
+    {"QR_DATA_READ", &QR_DATA_READ},
+    {"QR_IMAGE_READ", &QR_IMAGE_READ},
+    {"P1_LEFT_BLUE", &P1_LEFT_BLUE},
+    {"P1_LEFT_RED", &P1_LEFT_RED},
+    {"P1_RIGHT_RED", &P1_RIGHT_RED},
+    {"P1_RIGHT_BLUE", &P1_RIGHT_BLUE},
+    {"P2_LEFT_BLUE", &P2_LEFT_BLUE},
+    {"P2_LEFT_RED", &P2_LEFT_RED},
+    {"P2_RIGHT_RED", &P2_RIGHT_RED},
+    {"P2_RIGHT_BLUE", &P2_RIGHT_BLUE},
+};
+static_assert (std::size (namedBindings) == BINDING_COUNT && BINDING_COUNT <= MaxLogicalBindings);
+
 int exited        = 0;
 bool testEnabled  = false;
 int coin_count    = 0;
@@ -57,6 +115,10 @@ bool updateByCoin = false;
 HWND windowHandle = nullptr;
 HKL currentLayout;
 
+std::string usioStore;
+u32 usioFlush = 1000;
+UsioStore usio;
+
 namespace bnusio {
 #define RETURN_FALSE(returnType, functionName, ...) \
     returnType functionName (__VA_ARGS__) { return 0; }
@@ -69,15 +131,10 @@ RETURN_FALSE (u8, bnusio_IsConnected);
 RETURN_FALSE (i32, bnusio_ResetIoBoard);
 RETURN_FALSE (u16, bnusio_GetStatusU16, u16 a1);
 RETURN_FALSE (u8, bnusio_GetStatusU8, u16 a1);
-RETURN_FALSE (u16, bnusio_GetRegisterU16, i16 a1);
-RETURN_FALSE (u8, bnusio_GetRegisterU8, u16 a1);
 RETURN_FALSE (void *, bnusio_GetBuffer, u16 a1, i64 a2, i16 a3);
-RETURN_FALSE (i64, bnusio_SetRegisterU16, u16 a1, u16 a2);
-RETURN_FALSE (i64, bnusio_SetRegisterU8, u16 a1, u8 a2);
 RETURN_FALSE (i64, bnusio_SetBuffer, u16 a1, i32 a2, i16 a3);
 RETURN_FALSE (void *, bnusio_GetSystemError);
 RETURN_FALSE (i64, bnusio_SetSystemError, i16 a1);
-RETURN_FALSE (i64, bnusio_ClearSram);
 RETURN_FALSE (void *, bnusio_GetExpansionMode);
 RETURN_FALSE (i64, bnusio_SetExpansionMode, i16 a1);
 RETURN_FALSE (u8, bnusio_IsWideUsio);
@@ -95,13 +152,50 @@ RETURN_FALSE (void *, bnusio_SetPLCounter, i16 a1);
 RETURN_FALSE (char *, bnusio_GetIoBoardName);
 RETURN_FALSE (i64, bnusio_SetHopperRequest, u16 a1, i16 a2);
 RETURN_FALSE (i64, bnusio_SetHopperLimit, u16 a1, i16 a2);
-RETURN_FALSE (i64, bnusio_SramRead, i32 a1, u8 a2, i32 a3, u16 a4);
-RETURN_FALSE (i64, bnusio_SramWrite, i32 a1, u8 a2, i32 a3, u16 a4);
 RETURN_FALSE (void *, bnusio_GetCoinError, i32 a1);
 RETURN_FALSE (void *, bnusio_GetServiceError, i32 a1);
 RETURN_FALSE (i64, bnusio_DecCoin, i32 a1, u16 a2);
 RETURN_FALSE (i64, bnusio_DecService, i32 a1, u16 a2);
 RETURN_FALSE (i64, bnusio_ResetCoin);
+
+// Register and SRAM accesses only touch the in-memory state, the store commits them to disk from the flush task
+u16
+bnusio_GetRegisterU16 (const i16 a1) {
+    return usio.Read ([=] (const UsioState &state) -> u16 { return a1 >= 0 && a1 < std::size (state.registers16) ? state.registers16[a1] : 0; });
+}
+
+u8
+bnusio_GetRegisterU8 (const u16 a1) {
+    return usio.Read ([=] (const UsioState &state) -> u8 { return a1 < std::size (state.registers8) ? state.registers8[a1] : 0; });
+}
+
+i64
+bnusio_SetRegisterU16 (const u16 a1, const u16 a2) {
+    if (a1 < std::size (UsioState{}.registers16)) usio.Modify ([=] (UsioState &state) { state.registers16[a1] = a2; });
+    return 0;
+}
+
+i64
+bnusio_SetRegisterU8 (const u16 a1, const u8 a2) {
+    if (a1 < std::size (UsioState{}.registers8)) usio.Modify ([=] (UsioState &state) { state.registers8[a1] = a2; });
+    return 0;
+}
+
+// The arguments of bnusio_SramRead are not known, reads keep returning 0 and SRAM writes are only stored
+RETURN_FALSE (i64, bnusio_SramRead, i32 a1, u8 a2, i32 a3, u16 a4);
+
+i64
+bnusio_SramWrite (const i32 a1, const u8 a2, i32 a3, u16 a4) {
+    if (a1 >= 0 && a1 < std::size (UsioState{}.sram)) usio.Modify ([=] (UsioState &state) { state.sram[a1] = a2; });
+    return 0;
+}
+
+i64
+bnusio_ClearSram () {
+    usio.Modify ([] (UsioState &state) { memset (state.sram, 0, sizeof (state.sram)); });
+    return 0;
+}
+
 size_t
 bnusio_GetFirmwareVersion () {
     return 126;
@@ -109,12 +203,13 @@ bnusio_GetFirmwareVersion () {
 
 u32
 bnusio_GetSwIn () {
-    u32 sw = 0;
+    const LogicalInputFrame input = GetLogicalInput ();
+    u32 sw                        = 0;
     sw |= static_cast<u32> (testEnabled) << 7;
-    sw |= static_cast<u32> (IsButtonDown (DEBUG_ENTER)) << 9;
-    sw |= static_cast<u32> (IsButtonDown (DEBUG_DOWN)) << 12;
-    sw |= static_cast<u32> (IsButtonDown (DEBUG_UP)) << 13;
-    sw |= static_cast<u32> (IsButtonDown (SERVICE)) << 14;
+    sw |= static_cast<u32> (input.Down (BINDING_DEBUG_ENTER)) << 9;
+    sw |= static_cast<u32> (input.Down (BINDING_DEBUG_DOWN)) << 12;
+    sw |= static_cast<u32> (input.Down (BINDING_DEBUG_UP)) << 13;
+    sw |= static_cast<u32> (input.Down (BINDING_SERVICE)) << 14;
     return sw;
 }
 
@@ -124,60 +219,108 @@ bool valueStates[] = {false, false, false, false, false, false, false, false};
 Keybindings *analogButtons[]
     = {&P1_LEFT_BLUE, &P1_LEFT_RED, &P1_RIGHT_RED, &P1_RIGHT_BLUE, &P2_LEFT_BLUE, &P2_LEFT_RED, &P2_RIGHT_RED, &P2_RIGHT_BLUE};
 
-u16 buttonWaitPeriodP1 = 0;
-u16 buttonWaitPeriodP2 = 0;
-std::queue<u8> buttonQueueP1;
-std::queue<u8> buttonQueueP2;
+i64 hitInterval          = -1;
+u32 hitBacklog           = 16;
+DropPolicy hitDropPolicy = DropPolicy::Oldest;
+HitScheduler hitSchedulers[2];
+PadTaps padTaps;
+
+bool inputThread = false;
+u32 inputRate    = 1000;
+InputSampler inputSampler ([] {
+    u8 state = 0;
+    if (windowHandle == nullptr || GetForegroundWindow () != windowHandle) return state;
+    // UpdatePoll pumps the same joysticks on the game thread, the lock keeps the update and the reads apart from it
+    SDL_LockJoysticks ();
+    SDL_GameControllerUpdate ();
+    for (u8 i = 0; i < std::size (analogButtons); i++)
+        if (SampleButtonDown (*analogButtons[i])) state |= 1 << i;
+    SDL_UnlockJoysticks ();
+    return state;
+});
+
+const char *padNames[] = {"P1_LEFT_BLUE", "P1_LEFT_RED", "P1_RIGHT_RED", "P1_RIGHT_BLUE",
+                          "P2_LEFT_BLUE", "P2_LEFT_RED", "P2_RIGHT_RED", "P2_RIGHT_BLUE"};
+Histogram padLatency[8];
+Histogram playerLatency[2];
+u32 latencyReport = 0;
+std::string latencyCsv;
+u64 pollTimestamp = 0;
+
+std::string inputRecord;
+std::string inputReplay;
+InputRecorder recorder;
+InputReplay replay;
+
+// Without a Present hook the game calls bnusio_GetCoin several times per frame, frames are paced instead
+constexpr u64 CoinFrameInterval = 1000000 / 120;
+// How long exit waits for worker tasks such as UpdateAsync of plugins to return
+constexpr u64 StopTimeout = 500000;
+FrameScheduler scheduler (InputSampler::Now);
+
+// Replays run on recorded time so hit scheduling is reproducible
+u64
+InputNow () {
+    return replay.IsOpen () ? pollTimestamp : InputSampler::Now ();
+}
+
+void
+RecordLatency (const u8 which, const u64 timestamp, const u64 now) {
+    const u64 latency = now > timestamp ? now - timestamp : 0;
+    padLatency[which].Record (latency);
+    playerLatency[which / 4].Record (latency);
+}
+
+void
+QueueDrumHits () {
+    if (inputThread) {
+        DrumEvent event{};
+        while (inputSampler.Pop (event))
+            if (event.pressed) hitSchedulers[event.pad / 4].Push ({event.timestamp, static_cast<u8> (event.pad % 4)});
+        return;
+    }
+
+    padTaps.Queue (GetLogicalInput (), BINDING_P1_LEFT_BLUE, pollTimestamp, hitSchedulers);
+}
 
 bool analogInput;
 SDLAxis analogBindings[] = {
     SDL_AXIS_LEFT_LEFT,  SDL_AXIS_LEFT_RIGHT,  SDL_AXIS_LEFT_DOWN,  SDL_AXIS_LEFT_UP,  // P1: LB, LR, RR, RB
     SDL_AXIS_RIGHT_LEFT, SDL_AXIS_RIGHT_RIGHT, SDL_AXIS_RIGHT_DOWN, SDL_AXIS_RIGHT_UP, // P2: LB, LR, RR, RB
 };
+// Controller slot read by the analog drum of each player, AnySlot merges every controller
+int analogSlots[]   = {AnySlot, AnySlot};
+i64 analogThreshold = 100;
+i64 analogWindow    = 4000;
+i64 analogLockout   = 16000;
+VelocityDetector velocityDetectors[8];
+VelocityCurve velocityCurve;
+
+// Analog hits live on the SDL event clock, or on recorded time during a replay
+u64
+AnalogNow () {
+    return replay.IsOpen () ? pollTimestamp : static_cast<u64> (SDL_GetTicks ()) * 1000;
+}
+
+void
+FeedAnalogDrums (const int slot, const SDLAxis axis, const float value, const u64 timestamp) {
+    for (u8 i = 0; i < std::size (analogBindings); i++)
+        if (analogBindings[i] == axis && (analogSlots[i / 4] == AnySlot || analogSlots[i / 4] == slot)) velocityDetectors[i].Feed (value, timestamp);
+}
 
 u16
 bnusio_GetAnalogIn (const u8 which) {
     if (analogInput) {
-        if (const u16 analogValue = static_cast<u16> (32768 * ControllerAxisIsDown (analogBindings[which])); analogValue > 100) return analogValue;
-        return 0;
-    }
-    const auto button = analogButtons[which];
-    if (which == 0) {
-        if (buttonWaitPeriodP1 > 0) buttonWaitPeriodP1--;
-        if (buttonWaitPeriodP2 > 0) buttonWaitPeriodP2--;
-    }
-    if (const bool isP1 = which / 4 == 0; (isP1 && !buttonQueueP1.empty ()) || (!isP1 && !buttonQueueP2.empty ())) {
-        if ((isP1 && buttonQueueP1.front () == which && buttonWaitPeriodP1 == 0)
-            || (!isP1 && buttonQueueP2.front () == which && buttonWaitPeriodP2 == 0)) {
-            if (isP1) {
-                buttonQueueP1.pop ();
-                buttonWaitPeriodP1 = drumWaitPeriod;
-            } else {
-                buttonQueueP2.pop ();
-                buttonWaitPeriodP2 = drumWaitPeriod;
-            }
-
-            const u16 hitValue = !valueStates[which] ? 50 : 51;
-            valueStates[which] = !valueStates[which];
-            return (hitValue << 15) / 100 + 1;
-        }
-        if (IsButtonTapped (*button)) {
-            if (isP1) buttonQueueP1.push (which);
-            else buttonQueueP2.push (which);
+        const u64 now = AnalogNow ();
+        if (VelocityHit hit{}; velocityDetectors[which].Poll (now, hit)) {
+            RecordLatency (which, hit.timestamp, now);
+            return std::max<u16> (velocityCurve.Map (hit.peak), 1);
         }
         return 0;
-    } else if (IsButtonTapped (*button)) {
-        if (isP1 && buttonWaitPeriodP1 > 0) {
-            buttonQueueP1.push (which);
-            return 0;
-        }
-        if (!isP1 && buttonWaitPeriodP2 > 0) {
-            buttonQueueP2.push (which);
-            return 0;
-        }
-        if (isP1) buttonWaitPeriodP1 = drumWaitPeriod;
-        else buttonWaitPeriodP2 = drumWaitPeriod;
-
+    }
+    if (which == 0) QueueDrumHits ();
+    if (DrumHit hit{}; hitSchedulers[which / 4].Deliver (which % 4, InputNow (), hit)) {
+        RecordLatency (which, hit.timestamp, InputNow ());
         const u16 hitValue = !valueStates[which] ? 50 : 51;
         valueStates[which] = !valueStates[which];
         return (hitValue << 15) / 100 + 1;
@@ -276,45 +419,96 @@ Init () {
         if (const auto controller = openConfigSection (config, "controller")) {
             drumWaitPeriod = static_cast<u16> (readConfigInt (controller, "wait_period", drumWaitPeriod));
             analogInput    = readConfigBool (controller, "analog_input", analogInput);
+            inputThread    = readConfigBool (controller, "input_thread", inputThread);
+            inputRate      = static_cast<u32> (readConfigInt (controller, "input_rate", inputRate));
+            hitInterval    = readConfigInt (controller, "hit_interval", hitInterval);
+            hitBacklog     = static_cast<u32> (readConfigInt (controller, "hit_backlog", hitBacklog));
+            if (readConfigString (controller, "hit_drop", "oldest") == "newest") hitDropPolicy = DropPolicy::Newest;
+            latencyReport  = static_cast<u32> (readConfigInt (controller, "latency_report", latencyReport));
+            latencyCsv     = readConfigString (controller, "latency_csv", latencyCsv);
+            inputRecord    = readConfigString (controller, "input_record", inputRecord);
+            inputReplay    = readConfigString (controller, "input_replay", inputReplay);
+            velocityCurve.Build (readConfigIntArray (controller, "analog_curve", {0, 32768}));
+            analogThreshold = readConfigInt (controller, "analog_threshold", analogThreshold);
+            analogWindow    = readConfigInt (controller, "analog_window", analogWindow);
+            analogLockout   = readConfigInt (controller, "analog_lockout", analogLockout);
+            // 1-based like the slot prefix in keyconfig.toml, 0 for any controller
+            const auto slots = readConfigIntArray (controller, "analog_slots", {0, 0});
+            for (size_t i = 0; i < std::size (analogSlots) && i < slots.size (); i++)
+                analogSlots[i] = slots[i] >= 1 && slots[i] <= MaxControllers ? static_cast<int> (slots[i]) - 1 : AnySlot;
+            SetControllerSlots (readConfigStringArray (controller, "controller_slots", {}));
             if (analogInput) LogMessage (LogLevel::WARN, "Using analog input mode. All the keyboard drum inputs have been disabled.");
         }
+        if (const auto emulation = openConfigSection (config, "emulation")) {
+            usioStore = readConfigString (emulation, "usio_store", usioStore);
+            usioFlush = static_cast<u32> (readConfigInt (emulation, "usio_flush", usioFlush));
+        }
         auto graphics = openConfigSection (config, "graphics");
         if (graphics) {
             fpsLimit = (int)readConfigInt (graphics, "fpslimit", fpsLimit);
         }
     }
 
+    if (inputThread && (analogInput || inputRate == 0)) {
+        inputThread = false;
+        LogMessage (LogLevel::WARN, "Input thread needs digital input and a non-zero input_rate, sampling drums once per frame");
+    }
+
+    if (analogInput) {
+        const float threshold = static_cast<float> (analogThreshold) / 32768;
+        for (auto &detector : velocityDetectors)
+            detector.Configure (threshold, threshold / 2, static_cast<u64> (analogWindow), static_cast<u64> (analogLockout));
+        SetAxisMotionHandler (FeedAnalogDrums);
+    }
+
+    if (emulateUsio && !usioStore.empty ()) {
+        if (usio.Open (usioStore.c_str ())) {
+            usio.Read ([] (const UsioState &state) {
+                coin_count    = static_cast<int> (state.coins);
+                service_count = static_cast<int> (state.services);
+            });
+            LogMessage (LogLevel::INFO, "Loaded USIO state from {}, {} coins and {} services", usioStore, coin_count, service_count);
+        } else LogMessage (LogLevel::ERROR, "Failed to open USIO store {}", usioStore);
+    }
+
+    if (!inputReplay.empty ()) {
+        if (replay.Open (inputReplay.c_str ())) LogMessage (LogLevel::INFO, "Replaying {} input frames from {}", replay.Count (), inputReplay);
+        else LogMessage (LogLevel::ERROR, "Failed to open input recording {}", inputReplay);
+    }
+    if (!inputRecord.empty ()) {
+        if (recorder.Open (inputRecord.c_str ())) LogMessage (LogLevel::INFO, "Recording input frames to {}", inputRecord);
+        else LogMessage (LogLevel::ERROR, "Failed to open {} for input recording", inputRecord);
+    }
+    if (inputThread && (replay.IsOpen () || recorder.IsOpen ())) {
+        inputThread = false;
+        LogMessage (LogLevel::WARN, "Input recording and replay work on whole frames, sampling drums once per frame");
+    }
+
+    // wait_period was counted in polled frames, keep its meaning when no explicit interval is set
+    if (hitInterval < 0) hitInterval = static_cast<i64> (drumWaitPeriod) * 1000000 / (fpsLimit > 0 ? fpsLimit : 60);
+    if (hitBacklog < 1 || hitBacklog > MaxHitBacklog) {
+        hitBacklog = std::clamp<u32> (hitBacklog, 1, MaxHitBacklog);
+        LogMessage (LogLevel::WARN, "hit_backlog must be between 1 and {}, using {}", MaxHitBacklog, hitBacklog);
+    }
+    for (auto &scheduler : hitSchedulers)
+        scheduler.Configure (static_cast<u64> (hitInterval), hitBacklog, hitDropPolicy);
+
     updateByCoin = fpsLimit == 0;
     if (updateByCoin) {
         LogMessage (LogLevel::INFO, "fpsLimit is set to 0, bnusio::Update() will invoke in getCoin callback");
+        scheduler.SetFrameInterval (CoinFrameInterval);
     }
     const auto keyConfigPath = std::filesystem::current_path () / "keyconfig.toml";
     const std::unique_ptr<toml_table_t, void (*) (toml_table_t *)> keyConfig_ptr (openConfig (keyConfigPath), toml_free);
-    if (keyConfig_ptr) {
-        const toml_table_t *keyConfig = keyConfig_ptr.get ();
-        SetConfigValue (keyConfig, "EXIT", &EXIT);
-
-        SetConfigValue (keyConfig, "TEST", &TEST);
-        SetConfigValue (keyConfig, "SERVICE", &SERVICE);
-        SetConfigValue (keyConfig, "DEBUG_UP", &DEBUG_UP);
-        SetConfigValue (keyConfig, "DEBUG_DOWN", &DEBUG_DOWN);
-        SetConfigValue (keyConfig, "DEBUG_ENTER", &DEBUG_ENTER);
-
-        SetConfigValue (keyConfig, "COIN_ADD", &COIN_ADD);
-        SetConfigValue (keyConfig, "CARD_INSERT_1", &CARD_INSERT_1);
-        SetConfigValue (keyConfig, "CARD_INSERT_2", &CARD_INSERT_2);
-        SetConfigValue (keyConfig, "QR_DATA_READ", &QR_DATA_READ);
-        SetConfigValue (keyConfig, "QR_IMAGE_READ", &QR_IMAGE_READ);
-
-        SetConfigValue (keyConfig, "P1_LEFT_BLUE", &P1_LEFT_BLUE);
-        SetConfigValue (keyConfig, "P1_LEFT_RED", &P1_LEFT_RED);
-        SetConfigValue (keyConfig, "P1_RIGHT_RED", &P1_RIGHT_RED);
-        SetConfigValue (keyConfig, "P1_RIGHT_BLUE", &P1_RIGHT_BLUE);
-        SetConfigValue (keyConfig, "P2_LEFT_BLUE", &P2_LEFT_BLUE);
-        SetConfigValue (keyConfig, "P2_LEFT_RED", &P2_LEFT_RED);
-        SetConfigValue (keyConfig, "P2_RIGHT_RED", &P2_RIGHT_RED);
-        SetConfigValue (keyConfig, "P2_RIGHT_BLUE", &P2_RIGHT_BLUE);
+    const toml_table_t *keyConfig = keyConfig_ptr.get ();
+    static Keybindings *logicalBindings[BINDING_COUNT];
+    for (u8 i = 0; i < BINDING_COUNT; i++) {
+        const auto &[name, binding] = namedBindings[i];
+        if (keyConfig) SetConfigValue (keyConfig, name, binding);
+        else CompileKeybindings (binding);
+        logicalBindings[i] = binding;
     }
+    SetLogicalBindings (logicalBindings, BINDING_COUNT);
 
     if (!emulateUsio && !exists (std::filesystem::current_path () / "bnusio_original.dll")) {
         emulateUsio = true;
@@ -372,8 +566,97 @@ Init () {
 }
 
 void
-Update () {
+ReportLatency () {
+    const u64 now = InputSampler::Now ();
+
+    std::ofstream csv;
+    if (!latencyCsv.empty ()) {
+        const bool exists = std::filesystem::exists (latencyCsv);
+        csv.open (latencyCsv, std::ios::app);
+        if (!exists) csv << "time,source,count,p50,p99,max\n";
+    }
+
+    const auto report = [&] (const std::string &name, Histogram &histogram) {
+        if (histogram.Count () == 0) return;
+        const u64 p50 = histogram.Percentile (50), p99 = histogram.Percentile (99), max = histogram.Max ();
+        LogMessage (LogLevel::INFO, "[Latency] {}: {} hits, p50 {}us, p99 {}us, max {}us", name, histogram.Count (), p50, p99, max);
+        if (csv.is_open ()) csv << now << "," << name << "," << histogram.Count () << "," << p50 << "," << p99 << "," << max << "\n";
+        histogram.Reset ();
+    };
+    for (u8 i = 0; i < std::size (padLatency); i++)
+        report (padNames[i], padLatency[i]);
+    for (u8 i = 0; i < std::size (playerLatency); i++)
+        report (std::format ("P{}", i + 1), playerLatency[i]);
+}
+
+void
+PollInput () {
     if (exited && ++exited >= 50) ExitProcess (0);
+
+    if (replay.IsOpen ()) {
+        if (const InputSnapshot *snapshot = replay.Next ()) {
+            pollTimestamp = snapshot->timestamp;
+            ApplySnapshot (*snapshot);
+            // Recordings hold one axis value per frame instead of every event
+            if (analogInput)
+                for (u8 i = 0; i < std::size (analogBindings); i++)
+                    velocityDetectors[i].Feed (ControllerAxisIsDown (analogBindings[i], analogSlots[i / 4]), pollTimestamp);
+        } else {
+            LogMessage (LogLevel::INFO, "Input replay finished after {} frames, switching to live input", replay.Count ());
+            replay.Close ();
+        }
+    }
+    if (!replay.IsOpen ()) {
+        pollTimestamp = InputSampler::Now ();
+        UpdatePoll (windowHandle);
+    }
+    if (recorder.IsOpen ()) {
+        InputSnapshot snapshot{pollTimestamp};
+        CaptureSnapshot (snapshot);
+        recorder.Write (snapshot);
+    }
+    const LogicalInputFrame input = GetLogicalInput ();
+    if (input.tapped || input.released) {
+        BusEvent event = {BusEventType::Input};
+        event.input    = {input.down, input.tapped, input.released};
+        patches::Plugins::Publish (event);
+    }
+    std::vector<uint8_t> buffer = {};
+    const bool coin             = input.Tapped (BINDING_COIN_ADD) && !testEnabled;
+    const bool service          = input.Tapped (BINDING_SERVICE) && !testEnabled;
+    if (coin) coin_count++;
+    if (service) service_count++;
+    if (coin || service) {
+        usio.Modify ([] (UsioState &state) {
+            state.coins    = static_cast<u32> (coin_count);
+            state.services = static_cast<u32> (service_count);
+        });
+        BusEvent event      = {BusEventType::Coin};
+        event.coin.coins    = static_cast<u32> (coin_count);
+        event.coin.services = static_cast<u32> (service_count);
+        patches::Plugins::Publish (event);
+    }
+    const bool wasTestEnabled = testEnabled;
+    if (input.Tapped (BINDING_TEST)) testEnabled = !testEnabled;
+    if (input.Tapped (BINDING_EXIT)) { exited += 1; testEnabled = 1; }
+    if (testEnabled != wasTestEnabled) {
+        BusEvent event      = {BusEventType::TestMode};
+        event.status.active = testEnabled;
+        patches::Plugins::Publish (event);
+    }
+    if (GameVersion::CHN00 == gameVersion) {
+        if (input.Tapped (BINDING_CARD_INSERT_1)) patches::Scanner::Qr::CommitLogin (accessCode1);
+        if (input.Tapped (BINDING_CARD_INSERT_2)) patches::Scanner::Qr::CommitLogin (accessCode2);
+    } else {
+        if (input.Tapped (BINDING_CARD_INSERT_1)) patches::Scanner::Card::Commit (accessCode1, chipId1);
+        if (input.Tapped (BINDING_CARD_INSERT_2)) patches::Scanner::Card::Commit (accessCode2, chipId2);
+    }
+    if (input.Tapped (BINDING_QR_DATA_READ))  patches::Scanner::Qr::Commit (patches::Scanner::Qr::ReadQRData (buffer));
+    if (input.Tapped (BINDING_QR_IMAGE_READ)) patches::Scanner::Qr::Commit (patches::Scanner::Qr::ReadQRImage (buffer));
+}
+
+void
+Update () {
     if (!inited) {
         windowHandle = FindWindowA ("nuFoundation.Window", nullptr);
         InitializePoll (windowHandle);
@@ -383,34 +666,61 @@ Update () {
             ActivateKeyboardLayout (engLayout, KLF_SETFORPROCESS);
         }
 
+        if (inputThread) {
+            timeBeginPeriod (1);
+            inputSampler.Start (inputRate);
+            LogMessage (LogLevel::INFO, "Sampling drum inputs at {} Hz on the input thread", inputRate);
+        }
+
         patches::Plugins::Init ();
+        scheduler.SetStallHandler ([] (const FrameScheduler::Task &task) {
+            LogMessage (LogLevel::WARN, "{} is still running after its {}us budget, skipping it until it returns", task.name, task.budget);
+        });
+        scheduler.Add ("Input", TaskPhase::PrePresent, 1000, PollInput);
+        scheduler.Add ("Plugins", TaskPhase::PrePresent, 2000, patches::Plugins::Update);
+        patches::Plugins::Schedule (scheduler);
+        scheduler.Add ("Scanner", TaskPhase::PostPresent, 2000, patches::Scanner::Update);
+        if (latencyReport > 0)
+            scheduler.Add ("Latency report", TaskPhase::Periodic, 0, ReportLatency, static_cast<u64> (latencyReport) * 1000000, true);
+        if (Profiler::enabled && profileInterval > 0)
+            scheduler.Add ("Profile report", TaskPhase::Periodic, 0, [] { Profiler::Dump (profileCsv); }, static_cast<u64> (profileInterval) * 1000000, true);
+        if (usio.IsOpen ()) scheduler.Add ("USIO flush", TaskPhase::Periodic, 0, [] { usio.Flush (); }, static_cast<u64> (usioFlush) * 1000, true);
         inited = true;
     }
+    if (!scheduler.BeginFrame ()) return;
+    scheduler.Run (TaskPhase::PrePresent);
+    // Nothing is presented after the coin callback, so the rest of the frame runs right away
+    if (updateByCoin) PostPresent ();
+}
 
-    UpdatePoll (windowHandle);
-    std::vector<uint8_t> buffer = {};
-    if (IsButtonTapped (COIN_ADD) && !testEnabled) coin_count++;
-    if (IsButtonTapped (SERVICE)  && !testEnabled) service_count++;
-    if (IsButtonTapped (TEST)) testEnabled = !testEnabled;
-    if (IsButtonTapped (EXIT)) { exited += 1; testEnabled = 1; }
-    if (GameVersion::CHN00 == gameVersion) {
-        if (IsButtonTapped (CARD_INSERT_1)) patches::Scanner::Qr::CommitLogin (accessCode1);
-        if (IsButtonTapped (CARD_INSERT_2)) patches::Scanner::Qr::CommitLogin (accessCode2);
-    } else {
-        if (IsButtonTapped (CARD_INSERT_1)) patches::Scanner::Card::Commit (accessCode1, chipId1);
-        if (IsButtonTapped (CARD_INSERT_2)) patches::Scanner::Card::Commit (accessCode2, chipId2);
-    }
-    if (IsButtonTapped (QR_DATA_READ))  patches::Scanner::Qr::Commit (patches::Scanner::Qr::ReadQRData (buffer));
-    if (IsButtonTapped (QR_IMAGE_READ)) patches::Scanner::Qr::Commit (patches::Scanner::Qr::ReadQRImage (buffer));
-
-    patches::Plugins::Update ();
-    patches::Scanner::Update ();
+void
+PostPresent () {
+    scheduler.Run (TaskPhase::PostPresent);
 }
 
 void
 Close () {
     if (autoIme) ActivateKeyboardLayout (currentLayout, KLF_SETFORPROCESS);
+    if (inputSampler.Running ()) {
+        inputSampler.Stop ();
+        timeEndPeriod (1);
+        if (const u64 dropped = inputSampler.Dropped ()) LogMessage (LogLevel::WARN, "Input thread dropped {} drum events", dropped);
+    }
+    for (const auto *task : scheduler.Stop (StopTimeout))
+        LogMessage (LogLevel::ERROR, "{} did not return within {}ms at exit, leaving it running", task->name, StopTimeout / 1000);
+    for (const auto &task : scheduler.Tasks ())
+        if (const u64 overruns = task->overruns.load ())
+            LogMessage (LogLevel::WARN, "Task {} overran its {}us budget in {} of {} runs, p99 {}us, max {}us", task->name, task->budget, overruns,
+                        task->runs.load (), task->durations.Percentile (99), task->durations.Max ());
+    usio.Close ();
+    if (Profiler::enabled && !Profiler::Dump (profileCsv)) LogMessage (LogLevel::ERROR, "Failed to write profile to {}", profileCsv);
+    recorder.Close ();
+    replay.Close ();
+    for (u8 i = 0; i < std::size (hitSchedulers); i++)
+        if (const u64 dropped = hitSchedulers[i].Dropped ())
+            LogMessage (LogLevel::WARN, "P{} hit backlog overflowed, dropped {} drum hits", i + 1, dropped);
     patches::Plugins::Exit ();
+    Trace::Close ();
     CleanupLogger ();
 }
 } // namespace bnusio
@@ -2,5 +2,6 @@
 namespace bnusio {
 void Init ();
 void Update ();
+void PostPresent ();
 void Close ();
 } // namespace bnusio
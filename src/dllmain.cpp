@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <thread>
 #include "bnusio.h"
 #include "constants.h"
 #include "helpers.h"
@@ -25,14 +27,32 @@ char chipId2[33]        = "00000000000000000000000000000002";
 bool windowed           = false;
 bool autoIme            = false;
 bool jpLayout           = false;
+bool keyboardEvents     = false;
 bool cursor             = true;
 bool emulateUsio        = true;
 bool emulateCardReader  = true;
 bool emulateQr          = true;
 bool acceptInvalidCards = false;
-
-std::string logLevelStr = "INFO";
-bool logToFile          = true;
+bool pluginAsync        = false;
+u32 pluginWorkers       = 2;
+u32 pluginBudget        = 8;
+std::vector<std::string> hostPlugins;
+
+std::string logLevelStr      = "INFO";
+bool logToFile               = true;
+std::string logOverflowStr   = "drop";
+u32 logRate                  = 0;
+u32 logBurst                 = 10;
+bool logDedup                = true;
+u32 logFileSize              = 16;
+u32 logFileCount             = 3;
+std::string logFlushLevelStr = "WARN";
+u32 logFlushInterval         = 5;
+std::string profileCsv       = "profile.csv";
+u32 profileInterval          = 60;
+bool traceEnabled            = false;
+std::string traceFile        = "TaikoArcadeLoader.trace";
+u64 traceRecords             = 65536;
 
 HWND hGameWnd;
 HOOK (i32, ShowMouse, PROC_ADDRESS ("user32.dll", "ShowCursor"), bool) { return originalShowMouse (true); }
@@ -183,19 +203,49 @@ DllMain (HMODULE module, const DWORD reason, LPVOID reserved) {
                 cursor   = readConfigBool (graphics, "cursor", cursor);
             }
             if (const auto keyboard = openConfigSection (config, "keyboard")) {
-                autoIme  = readConfigBool (keyboard, "auto_ime", autoIme);
-                jpLayout = readConfigBool (keyboard, "jp_layout", jpLayout);
+                autoIme        = readConfigBool (keyboard, "auto_ime", autoIme);
+                jpLayout       = readConfigBool (keyboard, "jp_layout", jpLayout);
+                keyboardEvents = readConfigBool (keyboard, "event_input", keyboardEvents);
+            }
+
+            if (const auto pluginConfig = openConfigSection (config, "plugins")) {
+                pluginAsync   = readConfigBool (pluginConfig, "async_update", pluginAsync);
+                // A negative or huge value would otherwise wrap into billions of threads
+                const i64 maxWorkers = std::max (std::thread::hardware_concurrency (), 1u);
+                pluginWorkers        = static_cast<u32> (std::clamp<i64> (readConfigInt (pluginConfig, "async_workers", pluginWorkers), 1, maxWorkers));
+                pluginBudget         = static_cast<u32> (std::clamp<i64> (readConfigInt (pluginConfig, "async_budget", pluginBudget), 1, 1000));
+                hostPlugins          = readConfigStringArray (pluginConfig, "host_plugins", hostPlugins);
             }
 
             if (const auto logging = openConfigSection (config, "logging")) {
-                logLevelStr = readConfigString (logging, "log_level", logLevelStr);
-                logToFile   = readConfigBool (logging, "log_to_file", logToFile);
+                logLevelStr      = readConfigString (logging, "log_level", logLevelStr);
+                logToFile        = readConfigBool (logging, "log_to_file", logToFile);
+                logOverflowStr   = readConfigString (logging, "log_overflow", logOverflowStr);
+                logRate          = static_cast<u32> (std::clamp<i64> (readConfigInt (logging, "log_rate", logRate), 0, 100000));
+                logBurst         = static_cast<u32> (std::clamp<i64> (readConfigInt (logging, "log_burst", logBurst), 1, 100000));
+                logDedup         = readConfigBool (logging, "log_dedup", logDedup);
+                logFileSize      = static_cast<u32> (std::clamp<i64> (readConfigInt (logging, "log_file_size", logFileSize), 1, 1024));
+                logFileCount     = static_cast<u32> (std::clamp<i64> (readConfigInt (logging, "log_file_count", logFileCount), 1, 100));
+                logFlushLevelStr = readConfigString (logging, "log_flush_level", logFlushLevelStr);
+                logFlushInterval = static_cast<u32> (std::clamp<i64> (readConfigInt (logging, "log_flush_interval", logFlushInterval), 0, 3600));
+                Profiler::enabled.store (readConfigBool (logging, "profile", false));
+                profileCsv      = readConfigString (logging, "profile_csv", profileCsv);
+                profileInterval = static_cast<u32> (std::clamp<i64> (readConfigInt (logging, "profile_interval", profileInterval), 0, 86400));
+                traceEnabled    = readConfigBool (logging, "trace", traceEnabled);
+                traceFile       = readConfigString (logging, "trace_file", traceFile);
+                traceRecords    = static_cast<u64> (std::clamp<i64> (readConfigInt (logging, "trace_records", static_cast<i64> (traceRecords)), 1, 1 << 24));
             }
         }
 
         // Update the logger with the level read from config file.
-        InitializeLogger (GetLogLevel (logLevelStr), logToFile);
+        InitializeLogger (GetLogLevel (logLevelStr), logToFile, GetLogOverflow (logOverflowStr),
+                          {static_cast<size_t> (logFileSize) << 20, logFileCount, GetLogLevel (logFlushLevelStr), logFlushInterval});
+        SetLogSuppression (logRate, logBurst, logDedup);
         LogMessage (LogLevel::INFO, "Application started.");
+        if (traceEnabled) {
+            if (Trace::Open (traceFile, traceRecords)) LogMessage (LogLevel::INFO, "Tracing hooks to {}", traceFile);
+            else LogMessage (LogLevel::ERROR, "Failed to open trace file {}", traceFile);
+        }
 
         if (version == "auto") {
             GetGameVersion ();
@@ -0,0 +1,112 @@
+#include <algorithm>
+#include "drum.h"
+
+void
+HitScheduler::Configure (const uint64_t minInterval, const size_t backlog, const DropPolicy policy) {
+    this->minInterval = minInterval;
+    this->policy      = policy;
+    this->queue.SetCapacity (backlog);
+    this->delivered = false;
+}
+
+void
+HitScheduler::Push (const DrumHit &hit) {
+    if (this->policy == DropPolicy::Newest) this->queue.Push (hit);
+    else this->queue.PushOverwrite (hit);
+}
+
+bool
+HitScheduler::Deliver (const uint8_t pad, const uint64_t now, DrumHit &hit) {
+    if (this->queue.Empty () || this->queue.Front ().pad != pad) return false;
+    if (this->delivered && now - this->lastDelivery < this->minInterval) return false;
+
+    this->queue.Pop (hit);
+    this->lastDelivery = now;
+    this->delivered    = true;
+    return true;
+}
+
+void
+HitScheduler::Clear () {
+    this->queue.Clear ();
+    this->delivered = false;
+}
+
+void
+PadTaps::Queue (const LogicalInputFrame &frame, const size_t firstBinding, const uint64_t timestamp, HitScheduler (&schedulers)[2]) {
+    if (frame.sequence == this->sequence) return;
+    this->sequence = frame.sequence;
+    for (uint8_t i = 0; i < 8; i++)
+        if (frame.Tapped (firstBinding + i)) schedulers[i / 4].Push ({timestamp, static_cast<uint8_t> (i % 4)});
+}
+
+void
+VelocityDetector::Configure (const float threshold, const float release, const uint64_t window, const uint64_t lockout) {
+    this->threshold = threshold;
+    this->release   = std::min (release, threshold);
+    this->window    = window;
+    this->lockout   = std::max (lockout, window);
+    this->Clear ();
+}
+
+void
+VelocityDetector::Advance (const uint64_t now) {
+    if (this->phase == Phase::Peak && now - this->onset >= this->window) {
+        this->hits.PushOverwrite ({this->onset, this->peak});
+        this->phase = Phase::Lockout;
+    }
+    if (this->phase == Phase::Lockout && now - this->onset >= this->lockout && this->released) this->phase = Phase::Idle;
+}
+
+void
+VelocityDetector::Feed (const float value, const uint64_t timestamp) {
+    // Counted before advancing, so the sample that ends the lockout can also start the next hit
+    if (value < this->release) this->released = true;
+    this->Advance (timestamp);
+
+    switch (this->phase) {
+    case Phase::Idle:
+        if (value < this->threshold) break;
+        this->phase    = Phase::Peak;
+        this->onset    = timestamp;
+        this->peak     = value;
+        this->released = false;
+        break;
+    case Phase::Peak: this->peak = std::max (this->peak, value); break;
+    case Phase::Lockout: break;
+    }
+}
+
+bool
+VelocityDetector::Poll (const uint64_t now, VelocityHit &hit) {
+    this->Advance (now);
+    return this->hits.Pop (hit);
+}
+
+void
+VelocityDetector::Clear () {
+    this->phase    = Phase::Idle;
+    this->released = true;
+    this->hits.Clear ();
+}
+
+void
+VelocityCurve::Build (const std::vector<int64_t> &points) {
+    if (points.size () < 2) {
+        this->Build ({0, 32768});
+        return;
+    }
+
+    const size_t last = this->table.size () - 1;
+    for (size_t i = 0; i <= last; i++) {
+        const float position = static_cast<float> (i) * (points.size () - 1) / last;
+        const size_t index   = std::min (static_cast<size_t> (position), points.size () - 2);
+        const float value    = points[index] + (points[index + 1] - points[index]) * (position - index);
+        this->table[i]       = static_cast<uint16_t> (std::clamp (value + 0.5f, 0.0f, 65535.0f));
+    }
+}
+
+uint16_t
+VelocityCurve::Map (const float peak) const {
+    return this->table[static_cast<size_t> (std::clamp (peak, 0.0f, 1.0f) * (this->table.size () - 1) + 0.5f)];
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include <cstddef>
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "input.h"
+#include "ring.h"
+
+/* A drum hit on one of a player's four pads, timestamped in microseconds. */
+struct DrumHit {
+    uint64_t timestamp;
+    uint8_t pad;
+};
+
+enum class DropPolicy { Oldest, Newest };
+
+constexpr size_t MaxHitBacklog = 256;
+
+/* *
+ * Per player hit queue enforcing a minimum interval between delivered hits.
+ *
+ * Hits are delivered strictly in the order they were pushed, across all four pads,
+ * and never closer together than minInterval. When more than backlog hits are waiting,
+ * either the oldest queued hit or the incoming one is dropped.
+ * The queue has fixed storage so polling never allocates.
+ */
+class HitScheduler {
+public:
+    void Configure (uint64_t minInterval, size_t backlog, DropPolicy policy);
+    void Push (const DrumHit &hit);
+    bool Deliver (uint8_t pad, uint64_t now, DrumHit &hit);
+    void Clear ();
+
+    size_t Pending () const { return this->queue.Size (); }
+    size_t Backlog () const { return this->queue.Capacity (); }
+    uint64_t Dropped () const { return this->queue.Overflows (); }
+
+private:
+    uint64_t minInterval = 0;
+    DropPolicy policy    = DropPolicy::Oldest;
+
+    FixedRing<DrumHit, MaxHitBacklog> queue;
+    uint64_t lastDelivery = 0;
+    bool delivered        = false;
+};
+
+/* *
+ * Queues the taps of the eight pad bindings of a LogicalInputFrame, pads 0-3 to the first scheduler and 4-7 to the second.
+ *
+ * The game polls the drum several times per frame, a frame whose sequence was already queued is skipped
+ * so a tap is only pushed once.
+ */
+class PadTaps {
+public:
+    void Queue (const LogicalInputFrame &frame, size_t firstBinding, uint64_t timestamp, HitScheduler (&schedulers)[2]);
+
+private:
+    uint64_t sequence = 0; // Sequence 0 is the empty frame before the first poll
+};
+
+/* A detected analog hit, peak is the highest normalized axis value seen after the onset. */
+struct VelocityHit {
+    uint64_t timestamp;
+    float peak;
+};
+
+/* *
+ * Turns the raw axis samples of one analog pad into single hits.
+ *
+ * A hit starts when the signal reaches threshold, its peak is latched for window microseconds
+ * and it is then reported once. No new hit can start for lockout microseconds after the onset,
+ * nor before the signal fell under release, so sustained pressure does not retrigger.
+ */
+class VelocityDetector {
+public:
+    void Configure (float threshold, float release, uint64_t window, uint64_t lockout);
+    void Feed (float value, uint64_t timestamp);
+    bool Poll (uint64_t now, VelocityHit &hit);
+    void Clear ();
+
+private:
+    enum class Phase { Idle, Peak, Lockout };
+
+    void Advance (uint64_t now);
+
+    float threshold  = 0.01f;
+    float release    = 0.005f;
+    uint64_t window  = 0;
+    uint64_t lockout = 0;
+
+    Phase phase    = Phase::Idle;
+    uint64_t onset = 0;
+    float peak     = 0;
+    bool released  = true; // The signal fell under release since the onset
+    FixedRing<VelocityHit, 16> hits;
+};
+
+/* Maps a normalized peak to the value reported to the game through a 256 entry lookup table. */
+class VelocityCurve {
+public:
+    VelocityCurve () { this->Build ({0, 32768}); }
+
+    // Evenly spaced control points across the input range, linearly interpolated
+    void Build (const std::vector<int64_t> &points);
+    uint16_t Map (float peak) const;
+
+private:
+    std::array<uint16_t, 256> table{};
+};
@@ -0,0 +1,36 @@
+#include "eventbus.h"
+
+bool
+EventBus::Subscribe (const BusEventType type, const BusHandler handler, void *context) {
+    const auto index = static_cast<size_t> (type);
+    if (index >= this->subscribers.size () || handler == nullptr || this->subscriberCounts[index] == MaxSubscribers) return false;
+    this->subscribers[index][this->subscriberCounts[index]++] = {handler, context};
+    return true;
+}
+
+void
+EventBus::Dispatch (const BusEvent &event) const {
+    const auto index = static_cast<size_t> (event.type);
+    if (index >= this->subscribers.size ()) return;
+    for (size_t i = 0; i < this->subscriberCounts[index]; i++)
+        this->subscribers[index][i].handler (&event, this->subscribers[index][i].context);
+}
+
+BusEvent *
+EventBus::Acquire (const BusEventType type) {
+    if (type != BusEventType::CardCommit && type != BusEventType::QrCommit && type != BusEventType::QrLogin) return nullptr;
+    size_t position;
+    BusEvent *event = this->slots.Claim (position);
+    if (event == nullptr) {
+        this->dropped.fetch_add (1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    event->type     = type;
+    event->sequence = position;
+    return event;
+}
+
+void
+EventBus::Publish (const BusEvent *event) {
+    if (event != nullptr) this->slots.Commit (static_cast<size_t> (event->sequence));
+}
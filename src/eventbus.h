@@ -0,0 +1,126 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include "ring.h"
+
+/* *
+ * Versioned event bus shared with plugins.
+ *
+ * Plugins exporting ConnectEventBus receive the API table once every plugin is loaded. The loader dispatches
+ * frame, coin, test mode, card wait and QR window events to subscribers on the game thread, handlers get a pointer
+ * to the event and must not keep it past the call. Plugins publish card, QR and QR login commits from any thread by
+ * acquiring a slot in a preallocated ring, filling it in place and publishing it, the loader consumes the slot where it is.
+ * Members are only ever appended to the API table and event types to the enum, check version and size before using newer ones.
+ */
+constexpr uint32_t EventBusVersion = 2;
+constexpr size_t BusQrCapacity     = 600;
+
+enum class BusEventType : uint32_t {
+    // Loader to plugins
+    Frame,
+    Coin,
+    TestMode,
+    CardWait,
+    QrWindow,
+    // Plugins to loader
+    CardCommit,
+    QrCommit,
+    QrLogin,
+    // Loader to plugins, version 2
+    Input,
+    Count
+};
+
+struct BusFrame {
+    uint64_t frame;
+    uint64_t timestamp; // Microseconds, steady clock
+};
+
+struct BusCoin {
+    uint32_t coins;
+    uint32_t services;
+};
+
+struct BusStatus {
+    uint32_t active;
+};
+
+// Bit masks indexed by the bindings in keyconfig.toml order, starting with EXIT
+struct BusInput {
+    uint32_t down;
+    uint32_t tapped;
+    uint32_t released;
+};
+
+struct BusCard {
+    char accessCode[21];
+    char chipId[33];
+};
+
+struct BusQr {
+    uint32_t size;
+    uint8_t data[BusQrCapacity];
+};
+
+struct BusEvent {
+    BusEventType type;
+    uint32_t reserved;
+    uint64_t sequence; // Ring position of an acquired slot, do not change
+    union {
+        BusFrame frame;
+        BusCoin coin;
+        BusStatus status;
+        BusInput input;
+        BusCard card;
+        BusQr qr;
+    };
+};
+
+typedef void (*BusHandler) (const BusEvent *event, void *context);
+
+struct EventBusApi {
+    uint32_t version;
+    uint32_t size;
+    bool (*Subscribe) (BusEventType type, BusHandler handler, void *context);
+    // Returns nullptr when the ring is full or the type is not one plugins publish, every acquired slot must be published
+    BusEvent *(*Acquire) (BusEventType type);
+    void (*Publish) (BusEvent *event);
+};
+
+class EventBus {
+public:
+    static constexpr size_t MaxSubscribers = 16;
+    static constexpr size_t SlotCount      = 32;
+
+    // Not thread safe, subscribe before the first dispatch
+    bool Subscribe (BusEventType type, BusHandler handler, void *context);
+    void Dispatch (const BusEvent &event) const;
+    bool HasSubscribers (const BusEventType type) const { return this->subscriberCounts[static_cast<size_t> (type)] != 0; }
+
+    BusEvent *Acquire (BusEventType type);
+    void Publish (const BusEvent *event);
+
+    // Single consumer, hands every published slot to consume in order without copying it out
+    template <typename Function>
+    size_t
+    Drain (Function &&consume) {
+        size_t count = 0;
+        while (this->slots.Consume (consume)) count++;
+        return count;
+    }
+
+    uint64_t Dropped () const { return this->dropped.load (std::memory_order_relaxed); }
+
+private:
+    struct Subscriber {
+        BusHandler handler;
+        void *context;
+    };
+
+    std::array<std::array<Subscriber, MaxSubscribers>, static_cast<size_t> (BusEventType::Count)> subscribers{};
+    std::array<size_t, static_cast<size_t> (BusEventType::Count)> subscriberCounts{};
+    MpscRing<BusEvent, SlotCount> slots;
+    std::atomic<uint64_t> dropped{0};
+};
@@ -103,6 +103,25 @@ readConfigIntArray (const toml_table_t *table, const std::string &key, std::vect
     return ret;
 }
 
+std::vector<std::string>
+readConfigStringArray (const toml_table_t *table, const std::string &key, std::vector<std::string> notFoundValue) {
+    const toml_array_t *array = toml_array_in (table, key.c_str ());
+    if (!array) {
+        LogMessage (LogLevel::WARN, ("Could not find string Array named " + key).c_str ());
+        return notFoundValue;
+    }
+
+    std::vector<std::string> ret;
+    for (int i = 0;; i++) {
+        auto [ok, u] = toml_string_at (array, i);
+        if (!ok) break;
+        ret.push_back (u.s);
+        toml_myfree (u.s);
+    }
+
+    return ret;
+}
+
 std::wstring
 replace (const std::wstring &orignStr, const std::wstring &oldStr, const std::wstring &newStr) {
     size_t pos                              = 0;
@@ -171,8 +190,9 @@ ConvertWideToUtf8 (const std::wstring &wstr) {
     }
 
     // Allocate buffer and perform the conversion
-    std::string utf8Str (utf8Size, '\0'); // -1 to exclude null terminator
+    std::string utf8Str (utf8Size, '\0');
     WideCharToMultiByte (CP_UTF8, 0, wstr.c_str (), -1, data (utf8Str), utf8Size, nullptr, nullptr);
+    utf8Str.resize (utf8Size - 1); // Exclude the null terminator
 
     return utf8Str;
 }
@@ -13,6 +13,8 @@
 #include <windows.h>
 #include "constants.h"
 #include "logger.h"
+#include "profiler.h"
+#include "trace.h"
 
 typedef int8_t i8;
 typedef int16_t i16;
@@ -37,41 +39,69 @@ const HMODULE MODULE_HANDLE = GetModuleHandle (nullptr);
 #define ASLR(address) ((u64)MODULE_HANDLE + (u64)address - (u64)BASE_ADDRESS)
 #endif
 
+// Hooks are installed through a timing wrapper when built with PROFILING, see profiler.h
+#ifdef PROFILING
+#define PROFILE_SITE(functionName) static ProfileSite profileOf##functionName{#functionName};
+#define PROFILED(functionName)     (ProfiledHook<implOf##functionName, &profileOf##functionName>::Call)
+#else
+#define PROFILE_SITE(functionName)
+#define PROFILED(functionName)     implOf##functionName
+#endif
+
+// Records a HOOKS message into the binary trace when trace is enabled, see trace.h, otherwise logs it as text
+#define TRACE(...)                                                                          \
+    {                                                                                       \
+        if (Trace::enabled.load (std::memory_order_relaxed)) {                              \
+            static TraceSite traceSite;                                                     \
+            Trace::Record (traceSite, __FILE__, __LINE__, __VA_ARGS__);                     \
+        } else if (LogEnabled (LogLevel::HOOKS)) LogMessage (LogLevel::HOOKS, __VA_ARGS__); \
+    }
+
 #define HOOK(returnType, functionName, location, ...)         \
     typedef returnType (*functionName) (__VA_ARGS__);         \
     functionName original##functionName = nullptr;            \
     void *where##functionName           = (void *)(location); \
+    returnType implOf##functionName (__VA_ARGS__);            \
+    PROFILE_SITE (functionName)                               \
     returnType implOf##functionName (__VA_ARGS__)
 
 #define HOOK_DYNAMIC(returnType, functionName, ...)   \
     typedef returnType (*functionName) (__VA_ARGS__); \
     functionName original##functionName = nullptr;    \
     void *where##functionName           = nullptr;    \
+    returnType implOf##functionName (__VA_ARGS__);    \
+    PROFILE_SITE (functionName)                       \
     returnType implOf##functionName (__VA_ARGS__)
 
 #define VTABLE_HOOK(returnType, className, functionName, ...)                      \
     typedef returnType (*className##functionName) (className * This, __VA_ARGS__); \
     className##functionName original##className##functionName = nullptr;           \
     void *where##className##functionName                      = nullptr;           \
+    returnType implOf##className##functionName (className *This, __VA_ARGS__);     \
+    PROFILE_SITE (className##functionName)                                         \
     returnType implOf##className##functionName (className *This, __VA_ARGS__)
 
-#define MID_HOOK(functionName, location, ...)   \
-    typedef void (*functionName) (__VA_ARGS__); \
-    SafetyHookMid midHook##functionName{};      \
-    u64 where##functionName = (location);       \
+#define MID_HOOK(functionName, location, ...)           \
+    typedef void (*functionName) (__VA_ARGS__);         \
+    SafetyHookMid midHook##functionName{};              \
+    u64 where##functionName = (location);               \
+    void implOf##functionName (SafetyHookContext &ctx); \
+    PROFILE_SITE (functionName)                         \
     void implOf##functionName (SafetyHookContext &ctx)
 
-#define MID_HOOK_DYNAMIC(functionName, ...)           \
-    typedef void (*functionName) (__VA_ARGS__);       \
-    std::map<u64, SafetyHookMid> mapOf##functionName; \
+#define MID_HOOK_DYNAMIC(functionName, ...)             \
+    typedef void (*functionName) (__VA_ARGS__);         \
+    std::map<u64, SafetyHookMid> mapOf##functionName;   \
+    void implOf##functionName (SafetyHookContext &ctx); \
+    PROFILE_SITE (functionName)                         \
     void implOf##functionName (SafetyHookContext &ctx)
 
-#define INSTALL_HOOK(functionName)                                                                                     \
-    {                                                                                                                  \
-        LogMessage (LogLevel::DEBUG, std::string ("Installing hook for ") + #functionName);                            \
-        MH_Initialize ();                                                                                              \
-        MH_CreateHook ((void *)where##functionName, (void *)implOf##functionName, (void **)(&original##functionName)); \
-        MH_EnableHook ((void *)where##functionName);                                                                   \
+#define INSTALL_HOOK(functionName)                                                                                        \
+    {                                                                                                                     \
+        LogMessage (LogLevel::DEBUG, std::string ("Installing hook for ") + #functionName);                               \
+        MH_Initialize ();                                                                                                 \
+        MH_CreateHook ((void *)where##functionName, (void *)PROFILED (functionName), (void **)(&original##functionName)); \
+        MH_EnableHook ((void *)where##functionName);                                                                      \
     }
 
 #define INSTALL_HOOK_DYNAMIC(functionName, location) \
@@ -94,25 +124,27 @@ const HMODULE MODULE_HANDLE = GetModuleHandle (nullptr);
         INSTALL_HOOK (className##functionName);                                                 \
     }
 
-#define INSTALL_MID_HOOK(functionName)                                                              \
-    {                                                                                               \
-        LogMessage (LogLevel::DEBUG, std::string ("Installing mid hook for ") + #functionName);     \
-        midHook##functionName = safetyhook::create_mid (where##functionName, implOf##functionName); \
+#define INSTALL_MID_HOOK(functionName)                                                                 \
+    {                                                                                                  \
+        LogMessage (LogLevel::DEBUG, std::string ("Installing mid hook for ") + #functionName);        \
+        midHook##functionName = safetyhook::create_mid (where##functionName, PROFILED (functionName)); \
     }
 
 #define INSTALL_MID_HOOK_DYNAMIC(functionName, location) \
-    { mapOf##functionName[location] = safetyhook::create_mid (location, implOf##functionName); }
+    { mapOf##functionName[location] = safetyhook::create_mid (location, PROFILED (functionName)); }
 
 inline bool sendFlag = false;
-#define SCENE_RESULT_HOOK(functionName, location)                                                                                \
-    HOOK (void, functionName, location, i64 a1, i64 a2, i64 a3) {                                                                \
-        if (TestMode::ReadTestModeValue (L"ModInstantResult") != 1 && TestMode::ReadTestModeValue (L"NumberOfStageItem") <= 4) { \
-            original##functionName (a1, a2, a3);                                                                                 \
-            return;                                                                                                              \
-        }                                                                                                                        \
-        sendFlag = true;                                                                                                         \
-        original##functionName (a1, a2, a3);                                                                                     \
-        ExecuteSendResultData ();                                                                                                \
+#define SCENE_RESULT_HOOK(functionName, location)                                                                                              \
+    HOOK (void, functionName, location, i64 a1, i64 a2, i64 a3) {                                                                              \
+        const bool instant = TestMode::ReadTestModeValue (L"ModInstantResult") == 1 || TestMode::ReadTestModeValue (L"NumberOfStageItem") > 4; \
+        TRACE (#functionName " was called, instant result {}", instant);                                                                       \
+        if (!instant) {                                                                                                                        \
+            original##functionName (a1, a2, a3);                                                                                               \
+            return;                                                                                                                            \
+        }                                                                                                                                      \
+        sendFlag = true;                                                                                                                       \
+        original##functionName (a1, a2, a3);                                                                                                   \
+        ExecuteSendResultData ();                                                                                                              \
     }
 
 #define SEND_RESULT_HOOK(functionName, location)                                                                                 \
@@ -192,6 +224,7 @@ bool readConfigBool (const toml_table_t *table, const std::string &key, bool not
 i64 readConfigInt (const toml_table_t *table, const std::string &key, i64 notFoundValue);
 std::string readConfigString (const toml_table_t *table, const std::string &key, const std::string &notFoundValue);
 std::vector<i64> readConfigIntArray (const toml_table_t *table, const std::string &key, std::vector<i64> notFoundValue);
+std::vector<std::string> readConfigStringArray (const toml_table_t *table, const std::string &key, std::vector<std::string> notFoundValue);
 std::wstring replace (const std::wstring &orignStr, const std::wstring &oldStr, const std::wstring &newStr);
 std::string replace (const std::string &orignStr, const std::string &oldStr, const std::string &newStr);
 const char *GameVersionToString (GameVersion version);
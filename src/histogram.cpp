@@ -0,0 +1,50 @@
+#include <bit>
+#include <algorithm>
+#include <cmath>
+#include "histogram.h"
+
+size_t
+Histogram::BucketOf (const uint64_t value) {
+    if (value < SubBuckets) return value;
+    const int exponent = std::bit_width (value) - 1;
+    return SubBuckets + (exponent - 3) * SubBuckets + ((value >> (exponent - 3)) & (SubBuckets - 1));
+}
+
+uint64_t
+Histogram::BucketLimit (const size_t bucket) {
+    if (bucket < SubBuckets) return bucket;
+    const int shift = static_cast<int> ((bucket - SubBuckets) / SubBuckets);
+    const uint64_t lower = (SubBuckets + (bucket - SubBuckets) % SubBuckets) << shift;
+    return lower + ((uint64_t)1 << shift) - 1;
+}
+
+void
+Histogram::Record (const uint64_t value) {
+    this->buckets[BucketOf (value)].fetch_add (1, std::memory_order_relaxed);
+    this->count.fetch_add (1, std::memory_order_relaxed);
+
+    uint64_t current = this->max.load (std::memory_order_relaxed);
+    while (value > current && !this->max.compare_exchange_weak (current, value, std::memory_order_relaxed)) {}
+}
+
+void
+Histogram::Reset () {
+    for (auto &bucket : this->buckets)
+        bucket.store (0, std::memory_order_relaxed);
+    this->count.store (0, std::memory_order_relaxed);
+    this->max.store (0, std::memory_order_relaxed);
+}
+
+uint64_t
+Histogram::Percentile (const double percentile) const {
+    const uint64_t count = this->Count ();
+    if (count == 0) return 0;
+
+    const uint64_t target = std::max<uint64_t> (1, static_cast<uint64_t> (std::ceil (percentile / 100.0 * count)));
+    uint64_t seen         = 0;
+    for (size_t i = 0; i < BucketCount; i++) {
+        seen += this->buckets[i].load (std::memory_order_relaxed);
+        if (seen >= target) return std::min (BucketLimit (i), this->Max ());
+    }
+    return this->Max ();
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/* *
+ * Lock-free log-linear histogram of unsigned values, such as durations in microseconds.
+ *
+ * Every power of two is split into 8 buckets, so percentiles are within about 12% of the real value.
+ * Record may be called from any thread, readers see a consistent enough snapshot for reporting.
+ */
+class Histogram {
+public:
+    static constexpr size_t SubBuckets  = 8;
+    static constexpr size_t BucketCount = SubBuckets + (64 - 3) * SubBuckets;
+
+    void Record (uint64_t value);
+    void Reset ();
+
+    uint64_t Count () const { return this->count.load (std::memory_order_relaxed); }
+    uint64_t Max () const { return this->max.load (std::memory_order_relaxed); }
+    uint64_t Percentile (double percentile) const;
+
+private:
+    static size_t BucketOf (uint64_t value);
+    static uint64_t BucketLimit (size_t bucket);
+
+    std::array<std::atomic<uint32_t>, BucketCount> buckets{};
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> max{0};
+};
@@ -0,0 +1,103 @@
+#include <windows.h>
+#include <shellapi.h>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "eventbus.h"
+#include "ipc.h"
+
+/* *
+ * Plugin host: loads the plugins listed in host_plugins out of the game process.
+ *
+ * Started by TaikoArcadeLoader as TaikoPluginHost.exe <channel> <loader pid> <plugin>...
+ * Hosted plugins get Init, Update once per game frame, Exit and the event bus. Commits they publish
+ * are forwarded to the loader, the exports of the old card and QR API are not available here.
+ */
+
+typedef void (*BasicEvent)      ();
+typedef void (*ConnectBusEvent) (const EventBusApi *api);
+
+struct HostedPlugin {
+    HMODULE module;
+    BasicEvent init;
+    BasicEvent update;
+    BasicEvent exit;
+    ConnectBusEvent connectEventBus;
+};
+
+static EventBus bus;
+static IpcChannel channel;
+
+static bool
+BusSubscribe (const BusEventType type, const BusHandler handler, void *context) {
+    return bus.Subscribe (type, handler, context);
+}
+static BusEvent *
+BusAcquire (const BusEventType type) {
+    return bus.Acquire (type);
+}
+// Plugins commit from their own threads, the main loop forwards the commit right away
+static void
+BusPublish (BusEvent *event) {
+    bus.Publish (event);
+    channel.Interrupt ();
+}
+static const EventBusApi busApi = {EventBusVersion, sizeof (EventBusApi), BusSubscribe, BusAcquire, BusPublish};
+
+int
+main () {
+    // The narrow argv holds plugin paths in the ANSI code page, which cannot name every file
+    int argc       = 0;
+    wchar_t **argv = CommandLineToArgvW (GetCommandLineW (), &argc);
+    if (argv == nullptr || argc < 3) {
+        fprintf (stderr, "Usage: TaikoPluginHost <channel> <loader pid> <plugin>...\n");
+        return 1;
+    }
+    // The channel name is generated by the loader and always ASCII
+    std::string channelName;
+    for (const wchar_t *c = argv[1]; *c != L'\0'; c++) channelName += static_cast<char> (*c);
+    if (!channel.Open (channelName.c_str ())) {
+        fprintf (stderr, "Failed to open channel %s\n", channelName.c_str ());
+        return 1;
+    }
+    const HANDLE loader = OpenProcess (SYNCHRONIZE, FALSE, static_cast<DWORD> (wcstoul (argv[2], nullptr, 10)));
+
+    std::vector<HostedPlugin> plugins;
+    for (int i = 3; i < argc; i++) {
+        const HMODULE module = LoadLibraryW (argv[i]);
+        if (!module) {
+            fprintf (stderr, "Failed to load plugin %ls\n", argv[i]);
+            continue;
+        }
+        plugins.push_back ({module, reinterpret_cast<BasicEvent> (GetProcAddress (module, "Init")),
+                            reinterpret_cast<BasicEvent> (GetProcAddress (module, "Update")),
+                            reinterpret_cast<BasicEvent> (GetProcAddress (module, "Exit")),
+                            reinterpret_cast<ConnectBusEvent> (GetProcAddress (module, "ConnectEventBus"))});
+    }
+    for (const auto &plugin : plugins)
+        if (plugin.connectEventBus) plugin.connectEventBus (&busApi);
+    for (const auto &plugin : plugins)
+        if (plugin.init) plugin.init ();
+
+    // The loader may die without shutting the channel down, so never sleep for long
+    while (!channel.IsShutdown () && (loader == nullptr || WaitForSingleObject (loader, 0) == WAIT_TIMEOUT)) {
+        channel.Wait (100000);
+        channel.Receive ([&] (const BusEvent &event) {
+            if (event.type == BusEventType::Frame)
+                for (const auto &plugin : plugins)
+                    if (plugin.update) plugin.update ();
+            bus.Dispatch (event);
+        });
+        bus.Drain ([] (const BusEvent &event) {
+            if (!channel.Send (event)) fprintf (stderr, "Channel to the loader is full, dropped a commit\n");
+        });
+    }
+
+    for (const auto &plugin : plugins)
+        if (plugin.exit) plugin.exit ();
+    if (loader != nullptr) CloseHandle (loader);
+    channel.Close ();
+    LocalFree (argv);
+    return 0;
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/* *
+ * Source of keyboard state for the poll layer, one bit per virtual key code.
+ *
+ * Only watched keys need to be tracked. Read reports a key as down when it is held,
+ * or when it was pressed at any point since the previous Read, so short taps between frames are not lost.
+ */
+class InputBackend {
+public:
+    virtual ~InputBackend () = default;
+
+    virtual void Watch (const uint64_t (&keys)[4]) = 0;
+    virtual void Read (uint64_t (&keys)[4]) = 0;
+};
+
+/* Keyboard driven by explicit Press and Release calls, for running the poll layer without a window. */
+class SyntheticBackend final : public InputBackend {
+public:
+    void Watch (const uint64_t (&keys)[4]) override { memcpy (this->watched, keys, sizeof (this->watched)); }
+
+    void
+    Read (uint64_t (&keys)[4]) override {
+        for (int i = 0; i < 4; i++) {
+            keys[i]          = (this->down[i] | this->pressed[i]) & this->watched[i];
+            this->pressed[i] = 0;
+        }
+    }
+
+    void
+    Press (const uint8_t key) {
+        this->down[key / 64] |= 1ull << (key % 64);
+        this->pressed[key / 64] |= 1ull << (key % 64);
+    }
+
+    void Release (const uint8_t key) { this->down[key / 64] &= ~(1ull << (key % 64)); }
+
+private:
+    uint64_t watched[4] = {};
+    uint64_t down[4]    = {};
+    uint64_t pressed[4] = {};
+};
+
+constexpr size_t MaxLogicalBindings = 32;
+
+/* Down, tapped and released state of up to 32 named bindings for one polled frame, bit i belongs to binding i. */
+struct LogicalInputFrame {
+    uint64_t sequence;
+    uint32_t down;
+    uint32_t tapped;
+    uint32_t released;
+
+    bool Down (const size_t binding) const { return this->down >> binding & 1; }
+    bool Tapped (const size_t binding) const { return this->tapped >> binding & 1; }
+    bool Released (const size_t binding) const { return this->released >> binding & 1; }
+};
+
+/* *
+ * Hands whole LogicalInputFrames from one producer to any number of readers.
+ *
+ * Sequence lock: the counter is odd while a frame is being written and readers retry until they copied
+ * a frame that was not touched in between, so a reader never sees bits of two different frames.
+ */
+class LogicalInputChannel {
+public:
+    void
+    Publish (const uint32_t down, const uint32_t tapped, const uint32_t released) {
+        const uint64_t sequence = this->sequence.load (std::memory_order_relaxed);
+        this->sequence.store (sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence (std::memory_order_release);
+        this->down.store (down, std::memory_order_relaxed);
+        this->tapped.store (tapped, std::memory_order_relaxed);
+        this->released.store (released, std::memory_order_relaxed);
+        this->sequence.store (sequence + 2, std::memory_order_release);
+    }
+
+    LogicalInputFrame
+    Load () const {
+        LogicalInputFrame frame{};
+        for (;;) {
+            const uint64_t sequence = this->sequence.load (std::memory_order_acquire);
+            frame.down              = this->down.load (std::memory_order_relaxed);
+            frame.tapped            = this->tapped.load (std::memory_order_relaxed);
+            frame.released          = this->released.load (std::memory_order_relaxed);
+            std::atomic_thread_fence (std::memory_order_acquire);
+            if (!(sequence & 1) && this->sequence.load (std::memory_order_relaxed) == sequence) {
+                frame.sequence = sequence / 2;
+                return frame;
+            }
+        }
+    }
+
+private:
+    std::atomic<uint64_t> sequence{0};
+    std::atomic<uint32_t> down{0};
+    std::atomic<uint32_t> tapped{0};
+    std::atomic<uint32_t> released{0};
+};
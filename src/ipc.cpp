@@ -0,0 +1,166 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include "ipc.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <climits>
+#include <ctime>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static constexpr char channelMagic[4]    = {'T', 'P', 'H', 'C'};
+static constexpr uint32_t channelVersion = EventBusVersion;
+
+bool
+IpcChannel::Create (const char *name) {
+    this->Close ();
+    if (!this->Map (name, true)) return false;
+    // Ring 0 carries events to the host, ring 1 back to the loader
+    new (this->shared) Shared{};
+    memcpy (this->shared->magic, channelMagic, sizeof (channelMagic));
+    this->shared->version = channelVersion;
+    this->shared->size    = sizeof (Shared);
+    this->outgoingIndex   = 0;
+    this->incomingIndex   = 1;
+    this->outgoing        = &this->shared->rings[0];
+    this->incoming        = &this->shared->rings[1];
+    return true;
+}
+
+bool
+IpcChannel::Open (const char *name) {
+    this->Close ();
+    if (!this->Map (name, false)) return false;
+    if (memcmp (this->shared->magic, channelMagic, sizeof (channelMagic)) != 0 || this->shared->version != channelVersion
+        || this->shared->size != sizeof (Shared)) {
+        this->Close ();
+        return false;
+    }
+    this->outgoingIndex = 1;
+    this->incomingIndex = 0;
+    this->outgoing      = &this->shared->rings[1];
+    this->incoming      = &this->shared->rings[0];
+    return true;
+}
+
+bool
+IpcChannel::Send (const BusEvent &event) {
+    Ring &ring          = *this->outgoing;
+    const uint64_t head = ring.head.load (std::memory_order_relaxed);
+    if (head - ring.tail.load (std::memory_order_acquire) == SlotCount) {
+        this->dropped.fetch_add (1, std::memory_order_relaxed);
+        return false;
+    }
+    ring.slots[head % SlotCount] = event;
+    ring.head.store (head + 1, std::memory_order_seq_cst);
+    // Pairs with the receiver announcing it sleeps before it checks the ring a last time
+    if (ring.sleeping.load (std::memory_order_seq_cst)) this->Wake (ring, this->outgoingIndex);
+    return true;
+}
+
+bool
+IpcChannel::Wait (const uint32_t timeout) {
+    Ring &ring         = *this->incoming;
+    const auto pending = [&] {
+        return ring.head.load (std::memory_order_seq_cst) != ring.tail.load (std::memory_order_relaxed) || this->IsShutdown ();
+    };
+    // A wakeup sent for an earlier Wait can end the sleep without a new event, sleep again for the rest of the timeout
+    const auto deadline = std::chrono::steady_clock::now () + std::chrono::microseconds (timeout);
+    for (;;) {
+        const uint32_t seen = ring.signal.load (std::memory_order_acquire);
+        ring.sleeping.store (1, std::memory_order_seq_cst);
+        if (pending ()) break;
+        const auto remaining = std::chrono::duration_cast<std::chrono::microseconds> (deadline - std::chrono::steady_clock::now ()).count ();
+        if (remaining <= 0) break;
+#ifdef _WIN32
+        (void)seen;
+        WaitForSingleObject (this->events[this->incomingIndex], static_cast<DWORD> ((remaining + 999) / 1000));
+#else
+        const timespec limit = {static_cast<time_t> (remaining / 1000000), static_cast<long> (remaining % 1000000) * 1000};
+        syscall (SYS_futex, &ring.signal, FUTEX_WAIT, seen, &limit, nullptr, 0);
+#endif
+    }
+    ring.sleeping.store (0, std::memory_order_relaxed);
+    return pending ();
+}
+
+void
+IpcChannel::Wake (Ring &ring, const size_t index) {
+    ring.signal.fetch_add (1, std::memory_order_release);
+#ifdef _WIN32
+    SetEvent (this->events[index]);
+#else
+    (void)index;
+    syscall (SYS_futex, &ring.signal, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#endif
+}
+
+void
+IpcChannel::Shutdown () {
+    if (this->shared == nullptr) return;
+    this->shared->shutdown.store (1, std::memory_order_seq_cst);
+    this->Wake (this->shared->rings[0], 0);
+    this->Wake (this->shared->rings[1], 1);
+}
+
+bool
+IpcChannel::Map (const char *name, const bool create) {
+    this->owner = create;
+#ifdef _WIN32
+    char objectName[MAX_PATH];
+    snprintf (objectName, sizeof (objectName), "Local\\%s", name);
+    this->mapping = create ? CreateFileMappingA (INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, sizeof (Shared), objectName)
+                           : OpenFileMappingA (FILE_MAP_ALL_ACCESS, FALSE, objectName);
+    if (this->mapping == nullptr) return false;
+    void *view = MapViewOfFile (this->mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof (Shared));
+    bool ready = view != nullptr;
+    for (size_t i = 0; i < 2; i++) {
+        snprintf (objectName, sizeof (objectName), "Local\\%s.%zu", name, i);
+        this->events[i] = create ? CreateEventA (nullptr, FALSE, FALSE, objectName) : OpenEventA (EVENT_MODIFY_STATE | SYNCHRONIZE, FALSE, objectName);
+        ready           = ready && this->events[i] != nullptr;
+    }
+    if (ready) this->shared = static_cast<Shared *> (view);
+    else if (view != nullptr) UnmapViewOfFile (view);
+#else
+    snprintf (this->path, sizeof (this->path), "/%s", name);
+    const int fd = shm_open (this->path, create ? O_RDWR | O_CREAT | O_TRUNC : O_RDWR, 0600);
+    if (fd < 0) return false;
+    if (!create || ftruncate (fd, sizeof (Shared)) == 0)
+        if (void *view = mmap (nullptr, sizeof (Shared), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0); view != MAP_FAILED)
+            this->shared = static_cast<Shared *> (view);
+    close (fd);
+#endif
+    if (this->shared == nullptr) {
+        this->Close ();
+        return false;
+    }
+    return true;
+}
+
+void
+IpcChannel::Close () {
+#ifdef _WIN32
+    if (this->shared != nullptr) UnmapViewOfFile (this->shared);
+    for (auto &event : this->events) {
+        if (event != nullptr) CloseHandle (event);
+        event = nullptr;
+    }
+    if (this->mapping != nullptr) CloseHandle (this->mapping);
+    this->mapping = nullptr;
+#else
+    if (this->shared != nullptr) munmap (this->shared, sizeof (Shared));
+    if (this->owner && this->path[0] != '\0') shm_unlink (this->path);
+    this->path[0] = '\0';
+#endif
+    this->shared   = nullptr;
+    this->outgoing = nullptr;
+    this->incoming = nullptr;
+    this->owner    = false;
+}
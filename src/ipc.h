@@ -0,0 +1,82 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include "eventbus.h"
+
+/* *
+ * Bus events between TaikoArcadeLoader and the plugin host process over shared memory.
+ *
+ * The loader creates the channel and the host opens it by name. Each direction is a single producer,
+ * single consumer ring of events, Send never blocks and fails when the ring is full. A receiver that
+ * ran out of events sleeps in Wait, senders only pay for a wakeup (a futex on Linux, a named event on Windows)
+ * while the other side is actually sleeping.
+ */
+class IpcChannel {
+public:
+    static constexpr size_t SlotCount = 64;
+
+    struct Ring {
+        alignas (64) std::atomic<uint64_t> head;
+        alignas (64) std::atomic<uint64_t> tail;
+        alignas (64) std::atomic<uint32_t> signal;
+        std::atomic<uint32_t> sleeping;
+        BusEvent slots[SlotCount];
+    };
+
+    struct Shared {
+        char magic[4];
+        uint32_t version;
+        uint32_t size;
+        std::atomic<uint32_t> shutdown;
+        Ring rings[2];
+    };
+    static_assert (std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free);
+
+    ~IpcChannel () { this->Close (); }
+
+    bool Create (const char *name);
+    bool Open (const char *name);
+    void Close ();
+    bool IsOpen () const { return this->shared != nullptr; }
+
+    bool Send (const BusEvent &event);
+
+    // Hands every received event to consume in place, in the order it was sent
+    template <typename Function>
+    size_t
+    Receive (Function &&consume) {
+        Ring &ring          = *this->incoming;
+        const uint64_t tail = ring.tail.load (std::memory_order_relaxed);
+        const uint64_t head = ring.head.load (std::memory_order_acquire);
+        for (uint64_t i = tail; i != head; i++) consume (static_cast<const BusEvent &> (ring.slots[i % SlotCount]));
+        ring.tail.store (head, std::memory_order_release);
+        return static_cast<size_t> (head - tail);
+    }
+
+    // Sleeps until an event arrives, either side shuts the channel down or timeout microseconds pass
+    bool Wait (uint32_t timeout);
+    // Wakes a Wait of this side, from any thread
+    void Interrupt () { this->Wake (*this->incoming, this->incomingIndex); }
+    void Shutdown ();
+    bool IsShutdown () const { return this->shared != nullptr && this->shared->shutdown.load (std::memory_order_acquire) != 0; }
+    uint64_t Dropped () const { return this->dropped.load (std::memory_order_relaxed); }
+
+private:
+    bool Map (const char *name, bool create);
+    void Wake (Ring &ring, size_t index);
+
+    Shared *shared       = nullptr;
+    Ring *outgoing       = nullptr;
+    Ring *incoming       = nullptr;
+    size_t outgoingIndex = 0;
+    size_t incomingIndex = 0;
+    bool owner           = false;
+    std::atomic<uint64_t> dropped{0};
+#ifdef _WIN32
+    void *mapping   = nullptr;
+    void *events[2] = {};
+#else
+    char path[64] = {};
+#endif
+};
@@ -0,0 +1,130 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include "logfile.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// "# log length <bytes after the header>\n", fixed width so it can be rewritten in place
+static constexpr size_t HeaderSize   = 32;
+static constexpr char headerFormat[] = "# log length %018llu\n";
+static constexpr size_t MinimumSize  = 64 * 1024;
+
+// Length of the log recorded in the header of an existing file, -1 if it has none
+static long long
+RecordedLength (const std::string &path) {
+    FILE *file = fopen (path.c_str (), "rb");
+    if (file == nullptr) return -1;
+    char header[HeaderSize + 1] = {};
+    unsigned long long length   = 0;
+    const bool valid
+        = fread (header, 1, HeaderSize, file) == HeaderSize && sscanf (header, "# log length %llu", &length) == 1 && header[HeaderSize - 1] == '\n';
+    fclose (file);
+    return valid ? static_cast<long long> (length) : -1;
+}
+
+bool
+LogFile::Open (const std::string &path, size_t size, uint32_t count, bool rotate) {
+    this->Close ();
+    size  = std::max (size, MinimumSize);
+    count = std::max (count, 1u);
+    std::error_code error;
+
+    // Whatever a crash left after the recorded length is preallocated space
+    const long long recorded = RecordedLength (path);
+    if (recorded >= 0) std::filesystem::resize_file (path, HeaderSize + recorded, error);
+    if (recorded < 0 || HeaderSize + recorded >= size) rotate = rotate || std::filesystem::exists (path, error);
+    if (rotate) {
+        for (uint32_t i = count - 1; i > 0; i--) {
+            const std::string older = path + "." + std::to_string (i);
+            if (i == count - 1) std::filesystem::remove (older, error);
+            std::filesystem::rename (i == 1 ? path : path + "." + std::to_string (i - 1), older, error);
+        }
+        std::filesystem::remove (path, error);
+    }
+
+    void *view = nullptr;
+#ifdef _WIN32
+    // Readers may open the file while it is written, the view keeps the mapping and the file alive once both handles are closed
+    const HANDLE file = CreateFileA (path.c_str (), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_ALWAYS,
+                                     FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    if (const HANDLE mapping = CreateFileMappingA (file, nullptr, PAGE_READWRITE, static_cast<DWORD> (static_cast<uint64_t> (size) >> 32),
+                                                   static_cast<DWORD> (size), nullptr)) {
+        view = MapViewOfFile (mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+        CloseHandle (mapping);
+    }
+    CloseHandle (file);
+#else
+    const int fd = open (path.c_str (), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) return false;
+    if (ftruncate (fd, static_cast<off_t> (size)) == 0)
+        if (void *map = mmap (nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0); map != MAP_FAILED) view = map;
+    close (fd);
+#endif
+    if (view == nullptr) return false;
+
+    this->path   = path;
+    this->count  = count;
+    this->view   = static_cast<char *> (view);
+    this->size   = size;
+    this->offset = rotate || recorded < 0 ? HeaderSize : HeaderSize + static_cast<size_t> (recorded);
+    this->UpdateHeader ();
+    return true;
+}
+
+void
+LogFile::Write (std::string_view text) {
+    while (!text.empty () && this->view != nullptr) {
+        const size_t space = this->size - this->offset;
+        size_t part        = text.size ();
+        if (part > space) {
+            // Rotate between two lines, only a line longer than a whole file gets cut
+            const size_t newline = text.substr (0, space).rfind ('\n');
+            part                 = newline != std::string_view::npos ? newline + 1 : this->offset == HeaderSize ? space : 0;
+        }
+        memcpy (this->view + this->offset, text.data (), part);
+        this->offset += part;
+        text.remove_prefix (part);
+        if (!text.empty ()) this->Open (std::string (this->path), this->size, this->count, true);
+    }
+    if (this->view != nullptr) this->UpdateHeader ();
+}
+
+void
+LogFile::UpdateHeader () {
+    char header[HeaderSize + 8]; // Room for lengths past 18 digits, only HeaderSize bytes are copied
+    snprintf (header, sizeof (header), headerFormat, static_cast<unsigned long long> (this->offset - HeaderSize));
+    memcpy (this->view, header, HeaderSize);
+}
+
+void
+LogFile::Flush () {
+    if (this->view == nullptr) return;
+#ifdef _WIN32
+    FlushViewOfFile (this->view, this->offset);
+#else
+    msync (this->view, this->offset, MS_ASYNC);
+#endif
+}
+
+void
+LogFile::Close () {
+    if (this->view == nullptr) return;
+    this->UpdateHeader ();
+    this->Flush ();
+#ifdef _WIN32
+    UnmapViewOfFile (this->view);
+#else
+    munmap (this->view, this->size);
+#endif
+    this->view = nullptr;
+    std::error_code error;
+    std::filesystem::resize_file (this->path, this->offset, error);
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/* *
+ * Log file of a fixed size written through a memory mapping, rotated into numbered generations when full.
+ *
+ * The file is preallocated and starts with a short text header holding how many bytes of log follow it, updated after
+ * every write. A crash leaves the mapped pages to the OS, so nothing is lost without syncing each line, and the next
+ * Open trims what follows the recorded length. Flush only asks the OS to start writing the pages back.
+ */
+class LogFile {
+public:
+    ~LogFile () { this->Close (); }
+
+    // Keeps count files in total, moving path to path.1 and so on first when rotate is set, otherwise appends to path
+    bool Open (const std::string &path, size_t size, uint32_t count, bool rotate);
+    void Write (std::string_view text);
+    void Flush ();
+    // Flushes and cuts the file down to what was written
+    void Close ();
+    bool IsOpen () const { return this->view != nullptr; }
+
+private:
+    void UpdateHeader ();
+
+    std::string path;
+    uint32_t count = 0;
+    char *view     = nullptr;
+    size_t size    = 0;
+    size_t offset  = 0;
+};
@@ -1,102 +1,411 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <ctime>
 #include <iostream>
-#include <regex>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include "logfile.h"
 #include "logger.h"
+#include "ring.h"
+#ifdef _WIN32
+#include "helpers.h"
+#endif
+
+/* One queued message, the text is formatted by the caller and everything else by the writer. */
+struct LogRecord {
+    std::chrono::system_clock::time_point time;
+    LogLevel level;
+    int line;
+    const char *function;
+    const char *file;
+    uint32_t length;
+    uint32_t truncated;
+    uint32_t suppressed; // Messages of the same call site dropped by the rate limit since the last one written
+    char payload[LogMessageSize];
+};
 
 static Logger *loggerInstance = nullptr;
 void *consoleHandle           = nullptr;
-std::mutex logMutex; // Mutex for thread-safe logging
 
-char timeStr[64];
-time_t rawTime;
-tm *timeInfo;
-SYSTEMTIME systemTime;
+static constexpr size_t RecordCount = 512;
+static MpscRing<LogRecord, RecordCount> records;
+static std::atomic<uint64_t> dropped{0};
+static std::atomic<size_t> queued{0};
+static std::mutex consumeMutex; // Held by whoever drains the ring, producers never take it unless they block
+static std::mutex wakeMutex;
+static std::condition_variable wake;
+static std::thread *writer = nullptr; // Never destroyed, a joinable thread left to exit-time destructors would terminate
+static bool stopping       = false;
+#ifdef _WIN32
+static LPTOP_LEVEL_EXCEPTION_FILTER previousFilter = nullptr;
+#endif
+
+// Token bucket per call site, as the time its bucket is full again minus the burst (GCRA)
+struct RateSite {
+    std::atomic<uint64_t> key{0};
+    std::atomic<int64_t> tat{0};
+    std::atomic<uint32_t> suppressed{0};
+};
+static constexpr size_t RateSiteCount = 1024;
+static RateSite rateSites[RateSiteCount];
+static std::atomic<int64_t> rateInterval{0};  // Nanoseconds per token
+static std::atomic<int64_t> rateTolerance{0}; // Nanoseconds of burst
+static std::atomic<uint64_t> rateLimited{0};
+
+// Repeated messages, only touched while holding consumeMutex
+static bool dedup = false;
+static LogRecord lastRecord;
+static uint64_t repeats           = 0;
+static uint32_t repeatsSuppressed = 0;
+static std::chrono::system_clock::time_point firstRepeat;
+static std::chrono::system_clock::time_point lastRepeat;
+static std::atomic<uint64_t> repeated{0};
+
+// Formatting and file state, only touched while holding consumeMutex
+static LogFile logFile;
+static bool fileRotated  = false;
+static bool fileDirty    = false;
+static bool flushPending = false; // A message at flushLevel or worse was written since the last flush
+static std::chrono::steady_clock::time_point lastFlush;
+static std::string fileBatch;
+static time_t cachedSecond = 0;
+static char cachedTime[32];
+static std::unordered_map<const char *, std::string> shortFunctions;
+
+// "void __cdecl patches::Qr::Update(void)" becomes "patches::Qr::Update", computed once per function
+static const std::string &
+ShortFunction (const char *function) {
+    auto [entry, inserted] = shortFunctions.try_emplace (function);
+    if (!inserted) return entry->second;
+
+    const std::string_view name = function;
+    const size_t close          = name.rfind (')');
+    size_t open                 = std::string_view::npos;
+    for (size_t i = close, depth = 0; close != std::string_view::npos && i-- > 0;) {
+        if (name[i] == ')') depth++;
+        else if (name[i] == '(' && depth-- == 0) {
+            open = i;
+            break;
+        }
+    }
+    if (open == std::string_view::npos) return entry->second = name;
+
+    // Walk back to the space before the qualified name, skipping spaces inside template arguments and after "operator"
+    size_t start = 0;
+    for (size_t i = open, depth = 0; i-- > 0;) {
+        if (name[i] == '>') depth++;
+        else if (name[i] == '<' && depth > 0) depth--;
+        else if (name[i] == ' ' && depth == 0 && !name.substr (0, i).ends_with ("operator")) {
+            start = i + 1;
+            break;
+        }
+    }
+    return entry->second = name.substr (start, open - start);
+}
+
+static void
+Emit (const LogRecord &record) {
+    // Remove the absolute path of the build dir
+    constexpr std::string_view build_dir = XSTRING (SOURCE_ROOT);
+    std::string_view filename            = record.file;
+    if (filename.starts_with (build_dir.substr (0, build_dir.size () - 1))) filename.remove_prefix (build_dir.size ());
+
+    // localtime only once per second
+    const time_t second = std::chrono::system_clock::to_time_t (record.time);
+    if (second != cachedSecond) {
+        cachedSecond = second;
+        strftime (cachedTime, sizeof (cachedTime), "%Y/%m/%d %H:%M:%S", localtime (&second));
+    }
+    const auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds> (record.time.time_since_epoch ()).count () % 1000;
+    char timeStamp[40];
+    snprintf (timeStamp, sizeof (timeStamp), "%s.%03d", cachedTime, static_cast<int> (milliseconds));
+
+    std::string logMessage = ShortFunction (record.function) + " (" + std::string (filename) + ":" + std::to_string (record.line) + "): "
+                           + std::string (record.payload, record.length);
+    if (record.truncated) logMessage += " [" + std::to_string (record.truncated) + " more bytes]";
+    if (record.suppressed) logMessage += " [" + std::to_string (record.suppressed) + " more suppressed by log_rate]";
+    const std::string logType = GetLogLevelString (record.level);
+
+    // Print the log message
+    std::cout << "[" << timeStamp << "] "; // Timestamp
+#ifdef _WIN32
+    SetConsoleTextAttribute (consoleHandle, GetLogLevelColor (record.level));                                            // Set Level color
+    std::cout << logType;                                                                                                // Level
+    SetConsoleTextAttribute (consoleHandle, FOREGROUND_BLUE | FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_INTENSITY); // Reset console color
+#else
+    std::cout << "\033[" << GetLogLevelColor (record.level) << 'm' << logType << "\033[0m"; // Level in its color
+#endif
+    std::cout << logMessage << '\n'; // Log message
+
+    if (logFile.IsOpen ()) {
+        fileBatch.append ("[").append (timeStamp).append ("] ").append (logType).append (logMessage).append ("\n");
+        if (record.level <= loggerInstance->file.flushLevel) flushPending = true;
+    }
+}
+
+static void
+EmitRepeats () {
+    LogRecord notice  = lastRecord;
+    notice.time       = lastRepeat;
+    notice.truncated  = 0;
+    notice.suppressed = repeatsSuppressed;
+    notice.length     = static_cast<uint32_t> (
+        snprintf (notice.payload, sizeof (notice.payload), "Last message repeated %llu times", static_cast<unsigned long long> (repeats)));
+    Emit (notice);
+    repeats           = 0;
+    repeatsSuppressed = 0;
+}
+
+static void
+Write (const LogRecord &record) {
+    if (dedup) {
+        if (record.level == lastRecord.level && record.line == lastRecord.line && record.file == lastRecord.file && record.length == lastRecord.length
+            && memcmp (record.payload, lastRecord.payload, record.length) == 0) {
+            if (repeats++ == 0) firstRepeat = record.time;
+            lastRepeat = record.time;
+            repeatsSuppressed += record.suppressed;
+            repeated.fetch_add (1, std::memory_order_relaxed);
+            return;
+        }
+        if (repeats) EmitRepeats ();
+        memcpy (&lastRecord, &record, offsetof (LogRecord, payload) + record.length);
+    }
+    Emit (record);
+}
+
+// Caller holds consumeMutex, a final drain also writes how often the last message was repeated so far
+static void
+Drain (const bool final = false) {
+    queued.store (0, std::memory_order_relaxed);
+    size_t count = 0;
+    while (records.Consume (Write)) count++;
+    // A message repeated forever still shows up every 10 seconds
+    if (repeats && (final || std::chrono::system_clock::now () - firstRepeat >= std::chrono::seconds (10))) {
+        EmitRepeats ();
+        count++;
+    }
+    if (const uint64_t lost = dropped.exchange (0, std::memory_order_relaxed)) {
+        LogRecord notice = {std::chrono::system_clock::now (), LogLevel::WARN, __LINE__, __FUNCTION__, __FILE__, 0, 0, 0, {}};
+        notice.length    = static_cast<uint32_t> (snprintf (notice.payload, sizeof (notice.payload), "Log ring was full, dropped %llu messages",
+                                                            static_cast<unsigned long long> (lost)));
+        Emit (notice);
+        count++;
+    }
+    if (count != 0) std::cout.flush ();
+    if (!logFile.IsOpen ()) return;
+
+    // Lines only need to reach the mapping, the OS writes it back, flushing just makes that happen sooner
+    if (!fileBatch.empty ()) {
+        logFile.Write (fileBatch);
+        fileBatch.clear ();
+        fileDirty = true;
+    }
+    const auto now = std::chrono::steady_clock::now ();
+    if (fileDirty && (final || flushPending || now - lastFlush >= std::chrono::seconds (loggerInstance->file.flushInterval))) {
+        logFile.Flush ();
+        fileDirty    = false;
+        flushPending = false;
+        lastFlush    = now;
+    }
+}
+
+static void
+WriterLoop () {
+    std::unique_lock lock (wakeMutex);
+    while (!stopping) {
+        lock.unlock ();
+        {
+            std::lock_guard consume (consumeMutex);
+            Drain ();
+        }
+        lock.lock ();
+        // Producers only wake the writer for warnings, errors and a half full ring, the rest waits for the next batch
+        wake.wait_for (lock, std::chrono::milliseconds (50), [] { return stopping; });
+    }
+}
+
+#ifdef _WIN32
+static LONG WINAPI
+CrashFilter (EXCEPTION_POINTERS *exception) {
+    FlushLogger ();
+    return previousFilter ? previousFilter (exception) : EXCEPTION_CONTINUE_SEARCH;
+}
+#else
+// wchar_t holds UTF-32 outside of Windows
+static std::string
+ConvertWideToUtf8 (const std::wstring &wstr) {
+    constexpr uint8_t lead[] = {0x00, 0xC0, 0xE0, 0xF0};
+    std::string utf8Str;
+    for (const wchar_t c : wstr) {
+        const uint32_t code = static_cast<uint32_t> (c) <= 0x10FFFF ? static_cast<uint32_t> (c) : 0xFFFD;
+        const int extra     = code < 0x80 ? 0 : code < 0x800 ? 1 : code < 0x10000 ? 2 : 3;
+        utf8Str += static_cast<char> (lead[extra] | code >> 6 * extra);
+        for (int i = extra - 1; i >= 0; i--)
+            utf8Str += static_cast<char> (0x80 | (code >> 6 * i & 0x3F));
+    }
+    return utf8Str;
+}
+#endif
 
 void
-InitializeLogger (const LogLevel level, const bool logToFile) {
+InitializeLogger (const LogLevel level, const bool logToFile, const LogOverflow overflow, const LogFileSettings &file) {
     if (loggerInstance == nullptr) {
         loggerInstance = static_cast<Logger *> (malloc (sizeof (Logger)));
+        fileBatch.reserve (64 * 1024);
+        // Created under the loader lock it only starts running once DllMain returns, Enqueue copes with that
+        writer = new std::thread (WriterLoop);
+#ifdef _WIN32
         if (consoleHandle == nullptr) consoleHandle = GetStdHandle (STD_OUTPUT_HANDLE);
+        previousFilter = SetUnhandledExceptionFilter (CrashFilter);
+#endif
     }
 
-    loggerInstance->logLevel = level;
+    std::lock_guard consume (consumeMutex);
+    Drain (true);
+    loggerInstance->logLevel  = level;
+    loggerInstance->logToFile = logToFile;
+    loggerInstance->overflow  = overflow;
+    loggerInstance->file      = file;
+    activeLogLevel.store (level, std::memory_order_relaxed);
 
     if (logToFile) {
-        loggerInstance->logFile = fopen ("TaikoArcadeLoader.log", "w"); // Open in write mode
-        if (!loggerInstance->logFile) LogMessage (LogLevel::WARN, std::string ("Failed to open TaikoArcadeLoader.log for writing."));
-    } else loggerInstance->logFile = nullptr; // No file logging
+        // The previous session moves to TaikoArcadeLoader.log.1 once, reopening with new settings keeps this session in one file
+        if (!logFile.Open ("TaikoArcadeLoader.log", file.size, file.count, !fileRotated))
+            std::cout << "Failed to open TaikoArcadeLoader.log for writing." << std::endl;
+        fileRotated = true;
+        lastFlush   = std::chrono::steady_clock::now ();
+    } else logFile.Close (); // No file logging
 }
 
-void
-LogMessageHandler (const char *function, const char *codeFile, int codeLine, LogLevel messageLevel, const char *format, ...) {
-    // Return if no logger or log level is too high
-    if (loggerInstance == nullptr || messageLevel > loggerInstance->logLevel) return;
-
-    // Lock for thread safety
-    std::lock_guard lock (logMutex);
+// Slot of a call site, claimed on first use, nullptr once the table is full
+static RateSite *
+FindRateSite (const char *file, const int line, const bool claim) {
+    const uint64_t key = reinterpret_cast<uintptr_t> (file) ^ static_cast<uint64_t> (line) << 48;
+    for (size_t i = 0; i < 16; i++) {
+        RateSite &site   = rateSites[((key * 0x9E3779B97F4A7C15ull >> 54) + i) & (RateSiteCount - 1)];
+        uint64_t current = site.key.load (std::memory_order_acquire);
+        if (current == key) return &site;
+        if (current == 0 && claim && (site.key.compare_exchange_strong (current, key, std::memory_order_acq_rel) || current == key)) return &site;
+    }
+    return nullptr;
+}
 
-    // Format the user-provided message
-    va_list args;
-    va_start (args, format);
-    int requiredSize = vsnprintf (nullptr, 0, format, args) + 1; // +1 for null terminator
-    std::unique_ptr<char[]> buffer (new char[requiredSize]);     // Allocate buffer dynamically
-    vsnprintf (buffer.get (), requiredSize, format, args);       // Format the string
-    std::string formattedMessage (buffer.get ());                // Convert to std::string
-    va_end (args);
+bool
+LogRateAllowed (const char *file, const int line) {
+    RateSite *site = FindRateSite (file, line, true);
+    if (site == nullptr) return true;
+    const int64_t now       = std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now ().time_since_epoch ()).count ();
+    const int64_t interval  = rateInterval.load (std::memory_order_relaxed);
+    const int64_t tolerance = rateTolerance.load (std::memory_order_relaxed);
+    int64_t tat             = site->tat.load (std::memory_order_relaxed);
+    while (true) {
+        const int64_t start = std::max (tat, now);
+        if (start - now > tolerance) {
+            site->suppressed.fetch_add (1, std::memory_order_relaxed);
+            rateLimited.fetch_add (1, std::memory_order_relaxed);
+            return false;
+        }
+        if (site->tat.compare_exchange_weak (tat, start + interval, std::memory_order_relaxed)) return true;
+    }
+}
 
-    // Determine log type string
-    std::string logType = GetLogLevelString (messageLevel);
+void
+SetLogSuppression (const uint32_t ratePerSecond, const uint32_t burst, const bool dedupMessages) {
+    {
+        std::lock_guard consume (consumeMutex);
+        Drain (true);
+        dedup = dedupMessages;
+    }
+    const int64_t interval = ratePerSecond ? 1000000000 / ratePerSecond : 0;
+    rateInterval.store (interval, std::memory_order_relaxed);
+    rateTolerance.store (interval * (std::max<uint32_t> (burst, 1) - 1), std::memory_order_relaxed);
+    logRateLimited.store (ratePerSecond != 0, std::memory_order_relaxed);
+}
 
-    // Shrink function name by regex
-    std::string short_function (function);
-    std::regex re(R"(.*? (([\w<>]+::)*[\w]+( [()<>+-]+)?)\(\w+.*?\))");
-    short_function = std::regex_replace (short_function, re, "$1");
+static void
+Enqueue (const char *function, const char *codeFile, const int codeLine, const LogLevel messageLevel, const std::string_view message,
+         const size_t truncated) {
+    size_t position;
+    LogRecord *record = records.Claim (position);
+    while (record == nullptr) {
+        if (loggerInstance->overflow == LogOverflow::Drop) {
+            dropped.fetch_add (1, std::memory_order_relaxed);
+            return;
+        }
+        // Help draining instead of waiting, the writer may not be running yet
+        if (consumeMutex.try_lock ()) {
+            Drain ();
+            consumeMutex.unlock ();
+        } else std::this_thread::yield ();
+        record = records.Claim (position);
+    }
 
-    // Remove the absolute path of the build dir
-    constexpr std::string_view build_dir = XSTRING (SOURCE_ROOT);
-    std::string_view filename            = codeFile;
-    filename.remove_prefix (build_dir.size ());
-
-    // Get current time and milliseconds
-    SYSTEMTIME systemTime;
-    GetSystemTime (&systemTime);
-    time_t rawTime = time (nullptr);
-    tm *timeInfo   = localtime (&rawTime);
-    std::ostringstream timeStamp;
-    timeStamp << std::put_time (timeInfo, "%Y/%m/%d %H:%M:%S") << "." << std::setw (3) << std::setfill ('0') << systemTime.wMilliseconds;
-
-    // Construct the log message
-    std::ostringstream logStream;
-    logStream << short_function << " (" << filename << ":" << codeLine << "): " << formattedMessage;
-    std::string logMessage = logStream.str ();
+    const size_t length = std::min (message.size (), sizeof (record->payload));
+    record->time        = std::chrono::system_clock::now ();
+    record->level       = messageLevel;
+    record->line        = codeLine;
+    record->function    = function;
+    record->file        = codeFile;
+    record->length      = static_cast<uint32_t> (length);
+    record->truncated   = static_cast<uint32_t> (message.size () - length + truncated);
+    record->suppressed  = 0;
+    if (logRateLimited.load (std::memory_order_relaxed))
+        if (RateSite *site = FindRateSite (codeFile, codeLine, false)) record->suppressed = site->suppressed.exchange (0, std::memory_order_relaxed);
+    memcpy (record->payload, message.data (), length);
+    records.Commit (position);
 
-    // Print the log message
-    std::cout << "[" << timeStamp.str () << "] ";                                                                        // Timestamp
-    SetConsoleTextAttribute (consoleHandle, GetLogLevelColor (messageLevel));                                            // Set Level color
-    std::cout << logType;                                                                                                // Level
-    SetConsoleTextAttribute (consoleHandle, FOREGROUND_BLUE | FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_INTENSITY); // Reset console color
-    std::cout << logMessage << std::endl;                                                                                // Log message
-    std::cout.flush (); // Flush to ensure immediate writing
+    if (messageLevel <= LogLevel::WARN || queued.fetch_add (1, std::memory_order_relaxed) + 1 == RecordCount / 2) wake.notify_one ();
+}
 
-    if (loggerInstance->logFile != nullptr) {
-        fprintf (loggerInstance->logFile, "[%s] %s%s\n", timeStamp.str ().c_str (), logType.c_str (), logMessage.c_str ());
-        fflush (loggerInstance->logFile); // Flush to ensure immediate writing
-    }
+void
+LogMessageHandler (const char *function, const char *codeFile, const int codeLine, const LogLevel messageLevel, const std::string_view message,
+                   const size_t truncated) {
+    // Return if no logger or log level is too high
+    if (loggerInstance == nullptr || messageLevel > loggerInstance->logLevel) return;
+    Enqueue (function, codeFile, codeLine, messageLevel, message, truncated);
 }
 
 void
-LogMessageHandler (const char *function, const char *codeFile, const int codeLine, const LogLevel messageLevel, const wchar_t *format, ...) {
-    const std::string utf8Message = ConvertWideToUtf8 (format); // Convert wide string to UTF-8
+LogMessageHandler (const char *function, const char *codeFile, const int codeLine, const LogLevel messageLevel, const std::wstring_view message,
+                   const size_t truncated) {
+    if (loggerInstance == nullptr || messageLevel > loggerInstance->logLevel) return;
+    Enqueue (function, codeFile, codeLine, messageLevel, ConvertWideToUtf8 (std::wstring (message)), truncated); // Convert wide string to UTF-8
+}
 
-    va_list args;
-    va_start (args, format);
-    LogMessageHandler (function, codeFile, codeLine, messageLevel, utf8Message.c_str (), args); // Delegate to the original handler
-    va_end (args);
+void
+FlushLogger () {
+    if (loggerInstance == nullptr) return;
+    // Do not hang a crashing process on a writer that died while holding the lock
+    for (int attempt = 0; attempt < 100; attempt++) {
+        if (consumeMutex.try_lock ()) {
+            Drain (true);
+            consumeMutex.unlock ();
+            return;
+        }
+        std::this_thread::sleep_for (std::chrono::milliseconds (1));
+    }
 }
 
 void
 CleanupLogger () {
     if (loggerInstance != nullptr) {
-        if (loggerInstance->logFile) fclose (loggerInstance->logFile);
+        if (const uint64_t limited = rateLimited.load (), collapsed = repeated.load (); limited || collapsed)
+            LogMessage (LogLevel::INFO, "Suppressed {} log messages by log_rate and {} repeated ones", limited, collapsed);
+        {
+            std::lock_guard lock (wakeMutex);
+            stopping = true;
+        }
+        wake.notify_one ();
+        if (writer != nullptr) {
+            writer->join ();
+            delete writer;
+            writer = nullptr;
+        }
+        FlushLogger ();
+        logFile.Close ();
         free (loggerInstance);
         loggerInstance = nullptr;
     }
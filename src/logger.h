@@ -1,39 +1,125 @@
 #pragma once
 
-#include "helpers.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
 #include <source_location>
+#include <string>
 #include <string_view>
 #include <format>
-#include <wincon.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
 
 #define STRING(x)  #x
 #define XSTRING(x) STRING (x)
 
 enum class LogLevel {
     NONE = 0,
+    // windows.h defines ERROR
 #ifdef ERROR
 #undef ERROR
-    ERROR,
 #endif
+    ERROR,
     WARN,
     INFO,
     DEBUG,
     HOOKS
 };
 
+/* What a message does when the log ring is full: get dropped and counted, or wait for the writer. */
+enum class LogOverflow { Drop, Block };
+
+/* Size and generations of TaikoArcadeLoader.log, and when it is written back to disk. */
+struct LogFileSettings {
+    size_t size            = 16 * 1024 * 1024;
+    uint32_t count         = 3; // Files kept, including the current one
+    LogLevel flushLevel    = LogLevel::WARN;
+    uint32_t flushInterval = 5; // Seconds
+};
+
 /**
  * Logger Struct Used to Store Logging Preferences and State
  */
 typedef struct {
     LogLevel logLevel;
-    FILE *logFile;
+    bool logToFile;
+    LogOverflow overflow;
+    LogFileSettings file;
 } Logger;
 
-/* Initializes a global Logger instance. */
-void InitializeLogger (LogLevel level, bool logToFile);
+/* *
+ * Initializes a global Logger instance.
+ *
+ * Messages are queued as fixed-size records in a lock-free ring, a background thread formats them
+ * and writes them to the console and the log file in batches. Calling it again changes the settings,
+ * the log file is only rotated the first time it is opened, later calls keep appending to it.
+ */
+void InitializeLogger (LogLevel level, bool logToFile, LogOverflow overflow = LogOverflow::Drop, const LogFileSettings &file = {});
+
+void LogMessageHandler (const char *function, const char *codeFile, int codeLine, LogLevel messageLevel, std::string_view message, size_t truncated = 0);
+void LogMessageHandler (const char *function, const char *codeFile, int codeLine, LogLevel messageLevel, std::wstring_view message, size_t truncated = 0);
 
-void LogMessageHandler (const char *function, const char *codeFile, int codeLine, LogLevel messageLevel, const char *format, ...);
-void LogMessageHandler (const char *function, const char *codeFile, int codeLine, LogLevel messageLevel, const wchar_t *format, ...);
+/* Writes every queued message before returning, used on exit and crash. */
+void FlushLogger ();
+
+/* *
+ * Limits every call site to ratePerSecond messages with bursts of up to burst, 0 turns it off.
+ * With dedup, a message identical to the previous one is only counted and written as "last message repeated N times".
+ */
+void SetLogSuppression (uint32_t ratePerSecond, uint32_t burst, bool dedup);
+
+/* Takes a token from the bucket of a call site, false when it is empty. */
+bool LogRateAllowed (const char *file, int line);
+inline std::atomic<bool> logRateLimited{false};
+
+/* Level set by InitializeLogger, messages above it are dropped before they are formatted. */
+inline std::atomic<LogLevel> activeLogLevel{LogLevel::NONE};
+
+inline bool
+LogEnabled (const LogLevel level) {
+#ifdef LOG_STRIP_VERBOSE
+    // Levels are constants at nearly every call site, so the compiler drops these messages entirely
+    if (level >= LogLevel::DEBUG) return false;
+#endif
+    return level <= activeLogLevel.load (std::memory_order_relaxed);
+}
+
+inline bool
+LogAllowed (const std::source_location &loc) {
+    return !logRateLimited.load (std::memory_order_relaxed) || LogRateAllowed (loc.file_name (), static_cast<int> (loc.line ()));
+}
+
+// Longest message kept, the rest is cut and only counted
+constexpr size_t LogMessageSize = 976;
+
+/* A message formatted on the stack instead of into an allocated string. */
+template <typename Char>
+struct LogBuffer {
+    Char data[LogMessageSize];
+    size_t length   = 0;
+    size_t overflow = 0;
+
+    struct Output {
+        using difference_type = std::ptrdiff_t;
+        LogBuffer *buffer;
+
+        const Output &
+        operator= (const Char c) const {
+            if (this->buffer->length < LogMessageSize) this->buffer->data[this->buffer->length++] = c;
+            else this->buffer->overflow++;
+            return *this;
+        }
+        const Output &operator* () const { return *this; }
+        Output &operator++ () { return *this; }
+        Output operator++ (int) { return *this; }
+    };
+
+    Output Out () { return {this}; }
+    std::basic_string_view<Char> View () const { return {this->data, this->length}; }
+};
+static_assert (std::output_iterator<LogBuffer<char>::Output, const char &> && std::output_iterator<LogBuffer<wchar_t>::Output, const wchar_t &>);
 
 /* *
  * Logs a message with file and line information, if the log level permits.
@@ -44,14 +130,18 @@ template <typename... Args>
 struct LogMessage {
     LogMessage (const LogLevel level, const std::string_view format, Args &&...args,
                 const std::source_location &loc = std::source_location::current ()) {
-        std::string formatted_message = std::vformat(std::string(format), std::make_format_args(args...));
-        LogMessageHandler (loc.function_name (), loc.file_name (), loc.line (), level, formatted_message.c_str ());
+        if (!LogEnabled (level) || !LogAllowed (loc)) return;
+        LogBuffer<char> buffer;
+        std::vformat_to (buffer.Out (), format, std::make_format_args (args...));
+        LogMessageHandler (loc.function_name (), loc.file_name (), loc.line (), level, buffer.View (), buffer.overflow);
     }
 
     LogMessage (const LogLevel level, const std::wstring_view format, Args &&...args,
                 const std::source_location &loc = std::source_location::current ()) {
-        std::wstring formatted_message = std::vformat(std::wstring(format), std::make_wformat_args(args...));
-        LogMessageHandler (loc.function_name (), loc.file_name (), loc.line (), level, formatted_message.c_str ());
+        if (!LogEnabled (level) || !LogAllowed (loc)) return;
+        LogBuffer<wchar_t> buffer;
+        std::vformat_to (buffer.Out (), format, std::make_wformat_args (args...));
+        LogMessageHandler (loc.function_name (), loc.file_name (), loc.line (), level, buffer.View (), buffer.overflow);
     }
 };
 
@@ -61,11 +151,11 @@ struct LogMessage {
 template <>
 struct LogMessage<void> {
     LogMessage (const LogLevel level, const std::string_view format, const std::source_location &loc = std::source_location::current ()) {
-        LogMessageHandler (loc.function_name (), loc.file_name (), loc.line (), level, format.data ());
+        if (LogEnabled (level) && LogAllowed (loc)) LogMessageHandler (loc.function_name (), loc.file_name (), loc.line (), level, format);
     }
 
     LogMessage (const LogLevel level, const std::wstring_view format, const std::source_location &loc = std::source_location::current ()) {
-        LogMessageHandler (loc.function_name (), loc.file_name (), loc.line (), level, format.data ());
+        if (LogEnabled (level) && LogAllowed (loc)) LogMessageHandler (loc.function_name (), loc.file_name (), loc.line (), level, format);
     }
 };
 
@@ -101,9 +191,10 @@ GetLogLevelString (LogLevel messageLevel) {
     }
 }
 
-/* Converts a LogLevel type to an int for colors display in the console. */
+/* Converts a LogLevel type to an int for colors display in the console, a console attribute on Windows and an ANSI color elsewhere. */
 inline int
 GetLogLevelColor (const LogLevel messageLevel) {
+#ifdef _WIN32
     // Colors: https://i.sstatic.net/ZG625.png
     switch (messageLevel) {
     case LogLevel::DEBUG: return FOREGROUND_BLUE | FOREGROUND_INTENSITY;                  // Pale Blue
@@ -113,6 +204,22 @@ GetLogLevelColor (const LogLevel messageLevel) {
     case LogLevel::HOOKS: return FOREGROUND_BLUE | FOREGROUND_RED | FOREGROUND_INTENSITY; // Pale Purple
     default: return FOREGROUND_BLUE | FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_INTENSITY;
     }
+#else
+    switch (messageLevel) {
+    case LogLevel::DEBUG: return 94; // Pale Blue
+    case LogLevel::INFO: return 92;  // Pale Green
+    case LogLevel::WARN: return 33;  // Bright Yellow
+    case LogLevel::ERROR: return 31; // Bright RED
+    case LogLevel::HOOKS: return 95; // Pale Purple
+    default: return 97;
+    }
+#endif
+}
+
+/* Converts a string to a LogOverflow type. */
+inline LogOverflow
+GetLogOverflow (const std::string &overflowStr) {
+    return overflowStr == "block" ? LogOverflow::Block : LogOverflow::Drop;
 }
 
 /* Cleans up the logger, closing files if necessary. */
@@ -106,8 +106,10 @@ PresentWrap (IDXGISwapChain *pSwapChain, const UINT SyncInterval, const UINT Fla
     if (FpsLimiterEnable) FpsLimiter::Update ();
 
     bnusio::Update ();
+    const HRESULT hr = g_oldPresentWrap (pSwapChain, SyncInterval, Flags);
+    bnusio::PostPresent ();
 
-    return g_oldPresentWrap (pSwapChain, SyncInterval, Flags);
+    return hr;
 }
 
 static HRESULT STDMETHODCALLTYPE
@@ -115,8 +117,10 @@ Present1Wrap (IDXGISwapChain1 *pSwapChain, const UINT SyncInterval, const UINT F
     if (FpsLimiterEnable) FpsLimiter::Update ();
 
     bnusio::Update ();
+    const HRESULT hr = g_oldPresent1Wrap (pSwapChain, SyncInterval, Flags);
+    bnusio::PostPresent ();
 
-    return g_oldPresent1Wrap (pSwapChain, SyncInterval, Flags);
+    return hr;
 }
 
 static HRESULT STDMETHODCALLTYPE
@@ -5,6 +5,9 @@
 
 #include "constants.h"
 
+class FrameScheduler;
+struct BusEvent;
+
 namespace patches {
 namespace JPN00 {
 void Init ();
@@ -78,6 +81,7 @@ typedef bool (*CommitQrLoginCallback) (std::string);
 void Init           ();
 void Update         ();
 void Exit           ();
+void Schedule       (FrameScheduler &scheduler);
 // Lowlevel Card API
 void WaitTouch      (CallBackTouchCard callback, uint64_t touchData);
 // Lowlevel QR API
@@ -91,6 +95,8 @@ void InitCardReader (CommitCardCallback touch);
 void InitQRScanner  (CommitQrCallback scan);
 void InitQRLogin    (CommitQrLoginCallback login);
 void UpdateStatus   (size_t type, bool status);
+// Event bus
+void Publish        (const BusEvent &event);
 // Plugins Loader
 void LoadPlugins    ();
 } // namespace Plugins
@@ -109,6 +115,7 @@ namespace Qr {
 void Init        ();
 void Update      ();
 bool Commit      (std::vector<uint8_t> &buffer);
+bool Commit      (const uint8_t *data, size_t size);
 bool CommitLogin (std::string accessCode);
 std::vector<uint8_t> &ReadQRData  (std::vector<uint8_t> &buffer);
 std::vector<uint8_t> &ReadQRImage (std::vector<uint8_t> &buffer);
@@ -1,6 +1,15 @@
+#include <thread>
 #include "constants.h"
+#include "eventbus.h"
 #include "helpers.h"
+#include "ipc.h"
 #include "patches.h"
+#include "scheduler.h"
+
+extern bool pluginAsync;
+extern u32 pluginWorkers;
+extern u32 pluginBudget;
+extern std::vector<std::string> hostPlugins;
 
 namespace patches::Plugins {
     std::vector<HMODULE> plugins = {};
@@ -14,100 +23,400 @@ namespace patches::Plugins {
     typedef void   (*SendQRScannerEvent)  (CommitQrCallback scan);
     typedef void   (*SendQRLoginEvent)    (CommitQrLoginCallback login);
     typedef void   (*StatusChangeEvent)   (size_t type, bool status);
+    typedef void   (*ConnectBusEvent)     (const EventBusApi *api);
+
+    /* Every known export of a plugin, resolved once when it is loaded. */
+    struct Plugin {
+        HMODULE module;
+        std::string name;
+        BasicEvent init;
+        BasicEvent update;
+        BasicEvent updateAsync;
+        BasicEvent exit;
+        WaitTouchEvent waitTouch;
+        SendVersionEvent initQr;
+        CheckEvent usingQr;
+        CopyDataEvent getQr;
+        SendVersionEvent initVersion;
+        SendCardReaderEvent initCardReader;
+        SendQRScannerEvent initQrScanner;
+        SendQRLoginEvent initQrLogin;
+        StatusChangeEvent updateStatus;
+        ConnectBusEvent connectEventBus;
+        CheckEvent threadSafeInit;
+    };
+    std::vector<Plugin> loaded = {};
+
+    // Index of each export in exportNames
+    enum PluginExport : u8 {
+        EXPORT_INIT,
+        EXPORT_UPDATE,
+        EXPORT_UPDATE_ASYNC,
+        EXPORT_EXIT,
+        EXPORT_WAIT_TOUCH,
+        EXPORT_INIT_QR,
+        EXPORT_USING_QR,
+        EXPORT_GET_QR,
+        EXPORT_INIT_VERSION,
+        EXPORT_INIT_CARD_READER,
+        EXPORT_INIT_QR_SCANNER,
+        EXPORT_INIT_QR_LOGIN,
+        EXPORT_UPDATE_STATUS,
+        EXPORT_CONNECT_EVENT_BUS,
+        EXPORT_THREAD_SAFE_INIT,
+        EXPORT_COUNT
+    };
+    const char *exportNames[] = {
+        "Init",
+        "Update",
+        "UpdateAsync",
+        "Exit",
+        "WaitTouch",
+        "InitQr",
+        "UsingQr",
+        "GetQr",
+        "InitVersion",
+        "InitCardReader",
+        "InitQRScanner",
+        "InitQRLogin",
+        "UpdateStatus",
+        "ConnectEventBus",
+        "ThreadSafeInit",
+    };
+    static_assert (std::size (exportNames) == EXPORT_COUNT);
+
+    // Only the plugins implementing an event, so dispatch never checks for missing exports
+    std::vector<BasicEvent> exitEvents;
+    // Per-frame handlers keep the site timing them
+    struct TimedEvent {
+        BasicEvent event;
+        ProfileSite *site;
+    };
+    std::vector<TimedEvent> updateEvents, updateAsyncEvents;
+    std::vector<WaitTouchEvent> waitTouchEvents;
+    std::vector<SendVersionEvent> initQrEvents, initVersionEvents;
+    std::vector<const Plugin *> qrPlugins;
+    std::vector<SendCardReaderEvent> initCardReaderEvents;
+    std::vector<SendQRScannerEvent> initQrScannerEvents;
+    std::vector<SendQRLoginEvent> initQrLoginEvents;
+    std::vector<StatusChangeEvent> updateStatusEvents;
+
+    template <typename Event>
+    static void
+    Resolve (const HMODULE module, const PluginExport index, Event &event, std::vector<Event> *events = nullptr) {
+        event = reinterpret_cast<Event> (GetProcAddress (module, exportNames[index]));
+        if (event && events) events->push_back (event);
+    }
+
+    static void
+    Register (const HMODULE module, const std::string &name) {
+        Plugin plugin = {module, name};
+        Resolve (module, EXPORT_INIT, plugin.init);
+        Resolve (module, EXPORT_UPDATE, plugin.update);
+        Resolve (module, EXPORT_UPDATE_ASYNC, plugin.updateAsync);
+        // Sites are never freed, the profile report reads them until the process exits
+        if (plugin.update) updateEvents.push_back ({plugin.update, new ProfileSite (name + ":Update")});
+        if (plugin.updateAsync) updateAsyncEvents.push_back ({plugin.updateAsync, new ProfileSite (name + ":UpdateAsync")});
+        Resolve (module, EXPORT_EXIT, plugin.exit, &exitEvents);
+        Resolve (module, EXPORT_WAIT_TOUCH, plugin.waitTouch, &waitTouchEvents);
+        Resolve (module, EXPORT_INIT_QR, plugin.initQr, &initQrEvents);
+        Resolve (module, EXPORT_USING_QR, plugin.usingQr);
+        Resolve (module, EXPORT_GET_QR, plugin.getQr);
+        Resolve (module, EXPORT_INIT_VERSION, plugin.initVersion, &initVersionEvents);
+        Resolve (module, EXPORT_INIT_CARD_READER, plugin.initCardReader, &initCardReaderEvents);
+        Resolve (module, EXPORT_INIT_QR_SCANNER, plugin.initQrScanner, &initQrScannerEvents);
+        Resolve (module, EXPORT_INIT_QR_LOGIN, plugin.initQrLogin, &initQrLoginEvents);
+        Resolve (module, EXPORT_UPDATE_STATUS, plugin.updateStatus, &updateStatusEvents);
+        Resolve (module, EXPORT_CONNECT_EVENT_BUS, plugin.connectEventBus);
+        Resolve (module, EXPORT_THREAD_SAFE_INIT, plugin.threadSafeInit);
+        plugins.push_back (module);
+        loaded.push_back (plugin);
+    }
+
+    // Calls into plugins made before Init wait for it, so no plugin code beyond DllMain runs under the loader lock
+    bool initialized = false;
+    std::vector<std::function<void ()>> pendingInit;
+
+    static void
+    WhenInitialized (std::function<void ()> deliver) {
+        if (initialized) deliver ();
+        else pendingInit.push_back (std::move (deliver));
+    }
+
+    EventBus bus;
+    std::thread::id gameThread;
+    CommitCardCallback commitCard;
+    CommitQrCallback commitQr;
+    CommitQrLoginCallback commitQrLogin;
+    u64 frame = 0;
+
+    // Plugins running in TaikoPluginHost.exe
+    std::vector<std::filesystem::path> hostedPaths;
+    IpcChannel host;
+    std::mutex hostMutex;
+    HANDLE hostProcess = nullptr;
+
+    static bool
+    BusSubscribe (const BusEventType type, const BusHandler handler, void *context) {
+        return bus.Subscribe (type, handler, context);
+    }
+    static BusEvent *
+    BusAcquire (const BusEventType type) {
+        return bus.Acquire (type);
+    }
+    static void
+    BusPublish (BusEvent *event) {
+        bus.Publish (event);
+    }
+    const EventBusApi busApi = {EventBusVersion, sizeof (EventBusApi), BusSubscribe, BusAcquire, BusPublish};
+
+    static BusEvent *
+    AcquireSlot (const BusEventType type) {
+        BusEvent *event = bus.Acquire (type);
+        if (!event) LogMessage (LogLevel::WARN, "Too many plugin commits pending, dropping one ({} dropped so far)", bus.Dropped ());
+        return event;
+    }
+
+    static bool
+    OffGameThread () {
+        return pluginAsync && std::this_thread::get_id () != gameThread;
+    }
+
+    // The callbacks of the old API go through the bus as well when called off the game thread
+    static bool
+    DeferCardCommit (std::string accessCode, std::string chipId) {
+        if (!OffGameThread ()) return commitCard (accessCode, chipId);
+        BusEvent *event = AcquireSlot (BusEventType::CardCommit);
+        if (!event) return false;
+        event->card = {};
+        accessCode.copy (event->card.accessCode, sizeof (event->card.accessCode) - 1);
+        chipId.copy (event->card.chipId, sizeof (event->card.chipId) - 1);
+        bus.Publish (event);
+        return true;
+    }
+
+    static bool
+    DeferQrCommit (std::vector<uint8_t> &buffer) {
+        if (!OffGameThread ()) return commitQr (buffer);
+        if (buffer.size () > BusQrCapacity) return false;
+        BusEvent *event = AcquireSlot (BusEventType::QrCommit);
+        if (!event) return false;
+        event->qr.size = static_cast<uint32_t> (buffer.size ());
+        memcpy (event->qr.data, buffer.data (), buffer.size ());
+        bus.Publish (event);
+        return true;
+    }
+
+    static bool
+    DeferQrLogin (std::string accessCode) {
+        if (!OffGameThread ()) return commitQrLogin (accessCode);
+        BusEvent *event = AcquireSlot (BusEventType::QrLogin);
+        if (!event) return false;
+        event->card = {};
+        accessCode.copy (event->card.accessCode, sizeof (event->card.accessCode) - 1);
+        bus.Publish (event);
+        return true;
+    }
+
+    // Slots are read in place, strings from plugins are not trusted to be terminated
+    static void
+    ApplyCommit (const BusEvent &event) {
+        switch (event.type) {
+        case BusEventType::CardCommit:
+            if (commitCard)
+                commitCard (std::string (event.card.accessCode, strnlen (event.card.accessCode, sizeof (event.card.accessCode))),
+                            std::string (event.card.chipId, strnlen (event.card.chipId, sizeof (event.card.chipId))));
+            break;
+        case BusEventType::QrCommit:
+            if (event.qr.size <= BusQrCapacity) patches::Scanner::Qr::Commit (event.qr.data, event.qr.size);
+            break;
+        case BusEventType::QrLogin:
+            if (commitQrLogin) commitQrLogin (std::string (event.card.accessCode, strnlen (event.card.accessCode, sizeof (event.card.accessCode))));
+            break;
+        default: break;
+        }
+    }
+
+    void
+    Publish (const BusEvent &event) {
+        bus.Dispatch (event);
+        if (!host.IsOpen ()) return;
+        std::lock_guard lock (hostMutex);
+        if (!host.Send (event) && host.Dropped () == 1) LogMessage (LogLevel::WARN, "Plugin host is not keeping up, dropping events");
+    }
+
+    static void
+    StartHost () {
+        if (hostedPaths.empty ()) return;
+        const std::string channel = "TaikoArcadeLoader." + std::to_string (GetCurrentProcessId ());
+        if (!host.Create (channel.c_str ())) {
+            LogMessage (LogLevel::ERROR, "Failed to create the plugin host channel, {} plugins will not run", hostedPaths.size ());
+            return;
+        }
+        const auto executable    = std::filesystem::current_path () / "TaikoPluginHost.exe";
+        std::wstring commandLine = L"\"" + executable.wstring () + L"\" " + std::wstring (channel.begin (), channel.end ()) + L" "
+                                 + std::to_wstring (GetCurrentProcessId ());
+        for (const auto &path : hostedPaths) commandLine += L" \"" + path.wstring () + L"\"";
+
+        STARTUPINFOW startupInfo        = {sizeof (startupInfo)};
+        PROCESS_INFORMATION processInfo = {};
+        // The host is a console program, it would otherwise open a window over the game
+        if (!CreateProcessW (executable.wstring ().c_str (), commandLine.data (), nullptr, nullptr, FALSE, CREATE_NO_WINDOW, nullptr, nullptr,
+                             &startupInfo, &processInfo)) {
+            LogMessage (LogLevel::ERROR, L"Failed to start " + executable.wstring ());
+            host.Close ();
+            return;
+        }
+        CloseHandle (processInfo.hThread);
+        hostProcess = processInfo.hProcess;
+        LogMessage (LogLevel::INFO, "Started plugin host for {} plugins", hostedPaths.size ());
+    }
+
+    static void
+    StopHost () {
+        if (!host.IsOpen ()) return;
+        host.Shutdown ();
+        if (hostProcess) {
+            if (WaitForSingleObject (hostProcess, 1000) == WAIT_TIMEOUT) LogMessage (LogLevel::WARN, "Plugin host did not exit in time");
+            CloseHandle (hostProcess);
+            hostProcess = nullptr;
+        }
+        host.Close ();
+    }
 
     void
     Init () {
-        for (auto plugin : plugins) {
-            auto event = GetProcAddress (plugin, "Init");
-            if (event) ((BasicEvent)event) ();
+        gameThread = std::this_thread::get_id ();
+        // Not from LoadPlugins, processes should not be started under the loader lock
+        StartHost ();
+
+        const auto start = std::chrono::steady_clock::now ();
+        initialized      = true;
+        for (const auto &plugin : loaded)
+            if (plugin.connectEventBus) plugin.connectEventBus (&busApi);
+        for (const auto &deliver : pendingInit) deliver ();
+        pendingInit.clear ();
+
+        // Plugins declaring ThreadSafeInit run Init alongside each other and the rest, which keep their order
+        std::vector<std::thread> threads;
+        std::vector<BasicEvent> sequential;
+        for (const auto &plugin : loaded) {
+            if (!plugin.init) continue;
+            if (plugin.threadSafeInit && plugin.threadSafeInit ()) threads.emplace_back (plugin.init);
+            else sequential.push_back (plugin.init);
         }
+        for (const auto init : sequential) init ();
+        for (auto &thread : threads) thread.join ();
+        if (!threads.empty () || !sequential.empty ())
+            LogMessage (LogLevel::INFO, "Initialized {} plugins in {} ms, {} of them in parallel", threads.size () + sequential.size (),
+                        std::chrono::duration_cast<std::chrono::milliseconds> (std::chrono::steady_clock::now () - start).count (), threads.size ());
+    }
+    ProfileSite updateSite ("Plugins::Update");
+    ProfileSite updateStatusSite ("Plugins::UpdateStatus");
+    ProfileSite checkQrSite ("Plugins::CheckQr");
+
+    static void
+    Dispatch (const TimedEvent &event) {
+        PROFILE_SCOPE (*event.site);
+        event.event ();
     }
+
     void
     Update () {
-        for (auto plugin : plugins) {
-            auto event = GetProcAddress (plugin, "Update");
-            if (event) ((BasicEvent)event) ();
+        PROFILE_SCOPE (updateSite);
+        if (host.IsOpen () || bus.HasSubscribers (BusEventType::Frame)) {
+            const auto now        = std::chrono::steady_clock::now ().time_since_epoch ();
+            BusEvent event        = {BusEventType::Frame};
+            event.frame.frame     = frame;
+            event.frame.timestamp = std::chrono::duration_cast<std::chrono::microseconds> (now).count ();
+            Publish (event);
         }
+        frame++;
+        for (const auto &event : updateEvents) Dispatch (event);
+        if (!pluginAsync)
+            for (const auto &event : updateAsyncEvents) Dispatch (event);
+        bus.Drain (ApplyCommit);
+        if (host.IsOpen ()) host.Receive (ApplyCommit);
+    }
+    void
+    Schedule (FrameScheduler &scheduler) {
+        if (!pluginAsync || updateAsyncEvents.empty ()) return;
+        scheduler.SetWorkers (pluginWorkers);
+        for (const auto &event : updateAsyncEvents)
+            scheduler.Add (event.site->name.c_str (), TaskPhase::PrePresent, static_cast<u64> (pluginBudget) * 1000, [event] { Dispatch (event); }, 0, true);
+        LogMessage (LogLevel::INFO, "Running UpdateAsync of {} plugins on {} worker threads", updateAsyncEvents.size (), pluginWorkers);
     }
     void
     Exit () {
-        for (auto plugin : plugins) {
-            auto event = GetProcAddress (plugin, "Exit");
-            if (event) ((BasicEvent)event) ();
-        }
+        for (const auto event : exitEvents) event ();
+        StopHost ();
     }
     // Card API
-    void 
+    void
     WaitTouch (CallBackTouchCard callback, uint64_t touchData) {
-        for (auto plugin : plugins) {
-            auto event = GetProcAddress (plugin, "WaitTouch");
-            if (event) ((WaitTouchEvent)event) (callback, touchData);
-        }
+        for (const auto event : waitTouchEvents) event (callback, touchData);
     }
     // QR API (deprecated)
-    void 
+    void
     InitQr (GameVersion gameVersion) {
-        for (auto plugin : plugins) {
-            auto event = GetProcAddress (plugin, "InitQr");
-            if (event) ((SendVersionEvent)event) (gameVersion);
-        }
+        WhenInitialized ([gameVersion] {
+            for (const auto event : initQrEvents) event (gameVersion);
+        });
     }
     void
     UsingQr () {
-        for (auto plugin : plugins) {
-            auto event = GetProcAddress (plugin, "UsingQr");
-            if (event) ((BasicEvent)event) ();
-        }
+        for (const auto plugin : qrPlugins) plugin->usingQr ();
     }
-    void * 
+    void *
     CheckQr () {
-        for (auto plugin : plugins) {
-            auto event = GetProcAddress (plugin, "UsingQr");
-            if (event && ((CheckEvent)event) ()) return plugin;
-        }
+        PROFILE_SCOPE (checkQrSite);
+        for (const auto plugin : qrPlugins)
+            if (plugin->usingQr ()) return const_cast<Plugin *> (plugin);
         return nullptr;
     }
-    size_t 
+    size_t
     GetQr (void *plugin, size_t size, uint8_t *buffer) {
-        auto event = GetProcAddress (*(HMODULE *)plugin, "GetQr");
-        if (event) return ((CopyDataEvent)event) (size, buffer);
+        const auto event = static_cast<const Plugin *> (plugin)->getQr;
+        if (event) return event (size, buffer);
         else return 0;
     }
     // New API
     void
     InitVersion (GameVersion gameVersion) {
-        for (auto plugin : plugins) {
-            auto event = GetProcAddress (plugin, "InitVersion");
-            if (event) ((SendVersionEvent)event) (gameVersion);
-        }
+        WhenInitialized ([gameVersion] {
+            for (const auto event : initVersionEvents) event (gameVersion);
+        });
     }
     void
     InitCardReader (CommitCardCallback touch) {
-        for (auto plugin : plugins) {
-            auto event = GetProcAddress (plugin, "InitCardReader");
-            if (event) ((SendCardReaderEvent)event) (touch);
-        }
+        commitCard = touch;
+        WhenInitialized ([] {
+            for (const auto event : initCardReaderEvents) event (DeferCardCommit);
+        });
     }
     void
     InitQRScanner (CommitQrCallback scan) {
-        for (auto plugin : plugins) {
-            auto event = GetProcAddress (plugin, "InitQRScanner");
-            if (event) ((SendQRScannerEvent)event) (scan);
-        }
+        commitQr = scan;
+        WhenInitialized ([] {
+            for (const auto event : initQrScannerEvents) event (DeferQrCommit);
+        });
     }
     void
     InitQRLogin (CommitQrLoginCallback login) {
-        for (auto plugin : plugins) {
-            auto event = GetProcAddress (plugin, "InitQRLogin");
-            if (event) ((SendQRLoginEvent)event) (login);
-        }
+        commitQrLogin = login;
+        WhenInitialized ([] {
+            for (const auto event : initQrLoginEvents) event (DeferQrLogin);
+        });
     }
     void
     UpdateStatus (size_t type, bool status) {
         // printWarning ("Send UpdateStatus type=%d status=%d", type, status);
-        for (auto plugin : plugins) {
-            auto event = GetProcAddress (plugin, "UpdateStatus");
-            if (event) ((StatusChangeEvent)event) (type, status);
+        PROFILE_SCOPE (updateStatusSite);
+        for (const auto event : updateStatusEvents) event (type, status);
+        if (type == 1 || type == 2) {
+            BusEvent event      = {type == 1 ? BusEventType::CardWait : BusEventType::QrWindow};
+            event.status.active = status;
+            Publish (event);
         }
     }
 
@@ -116,22 +425,29 @@ namespace patches::Plugins {
         auto pluginPath = std::filesystem::current_path () / "plugins";
 
         if (std::filesystem::exists (pluginPath)) {
+            // LoadLibraryW takes the loader lock, which DllMain already holds, so plugins load one after another
             for (const auto &entry : std::filesystem::directory_iterator (pluginPath)) {
                 if (entry.path ().extension () == ".dll") {
+                    // Narrow path strings throw for names outside the ANSI code page, the config is UTF-8
+                    const auto fileName = ConvertWideToUtf8 (entry.path ().filename ().wstring ());
+                    if (std::find (hostPlugins.begin (), hostPlugins.end (), fileName) != hostPlugins.end ()) {
+                        hostedPaths.push_back (entry.path ());
+                        LogMessage (LogLevel::INFO, L"Plugin " + entry.path ().filename ().wstring () + L" runs in the plugin host");
+                        continue;
+                    }
                     auto name      = entry.path ().wstring ();
                     auto shortName = entry.path ().filename ().wstring ();
                     if (HMODULE hModule = LoadLibraryW (name.c_str ()); !hModule) {
                         LogMessage (LogLevel::ERROR, L"Failed to load plugin " + shortName);
                     } else {
-                        plugins.push_back (hModule);
+                        Register (hModule, fileName);
                         LogMessage (LogLevel::INFO, L"Loaded plugin " + shortName);
                     }
                 }
             }
         }
+        // Pointers into loaded stay valid once every plugin is in
+        for (const auto &plugin : loaded)
+            if (plugin.usingQr) qrPlugins.push_back (&plugin);
     }
-
-
-
-
 }
\ No newline at end of file
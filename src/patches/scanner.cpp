@@ -1,6 +1,7 @@
 #include "constants.h"
 #include "helpers.h"
 #include "patches.h"
+#include "ring.h"
 #include <ReadBarcode.h>
 #include <chrono>
 #include <cstdint>
@@ -8,7 +9,6 @@
 #include <fstream>
 #include <iostream>
 #include <vector>
-#include <queue>
 #define STB_IMAGE_IMPLEMENTATION
 #define STBI_WINDOWS_UTF8
 #include "stb_image.h"
@@ -215,7 +215,14 @@ namespace Card {
     }
 }
 namespace Qr {
-    std::queue<std::vector<uint8_t>> scanQueue;
+    constexpr size_t MaxQrSize = 600;
+
+    struct QrScan {
+        size_t size;
+        uint8_t data[MaxQrSize];
+    };
+
+    FixedRing<QrScan, 8> scanQueue;
     State state = State::Disable;
     long long lastScan;
 
@@ -244,21 +251,28 @@ namespace Qr {
     HOOK_DYNAMIC (i64, CopyData, i64, void *dest, int length) {
         patches::Plugins::UsingQr ();
         lastScan = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now ().time_since_epoch ()).count ();
-        if (state == State::CopyWait && scanQueue.size () > 0) {
-            std::vector<uint8_t> data = scanQueue.front ();
-            if ((int)data.size () > length) {
-                LogMessage (LogLevel::ERROR, "[QR] Not an effective code, length: {} require: {}", data.size (), length);
+        if (state == State::CopyWait && !scanQueue.Empty ()) {
+            const QrScan &data = scanQueue.Front ();
+            const size_t size  = data.size;
+            // A code larger than the game's buffer is dropped instead of overflowing it
+            if (length < 0 || size > static_cast<size_t> (length)) {
+                LogMessage (LogLevel::ERROR, "[QR] Not an effective code, length: {} require: {}", size, length);
+                scanQueue.Pop ();
+                if (scanQueue.Empty ()) state = State::Ready;
+                return 0;
             }
             std::stringstream hexStream;
             hexStream << std::hex << std::uppercase << std::setfill ('0') << std::setw (2);
-            for (size_t i = 0; i < data.size (); i++) hexStream << static_cast<int> (data[i]) << " ";
-            LogMessage (LogLevel::INFO, "[QR] Read QRData size: {} data: {}\n", data.size (), hexStream.str ());
-            memcpy (dest, data.data (), data.size () + 1);
-            scanQueue.pop ();
-            if (scanQueue.size () == 0) state = State::Ready;
-            return data.size ();
+            for (size_t i = 0; i < size; i++) hexStream << static_cast<int> (data.data[i]) << " ";
+            LogMessage (LogLevel::INFO, "[QR] Read QRData size: {} data: {}\n", size, hexStream.str ());
+            memcpy (dest, data.data, size);
+            // The terminator only when the buffer has room for it
+            if (size < static_cast<size_t> (length)) static_cast<u8 *> (dest)[size] = 0;
+            scanQueue.Pop ();
+            if (scanQueue.Empty ()) state = State::Ready;
+            return size;
         } else if (state == State::Disable) {
-            while (!scanQueue.empty ()) scanQueue.pop ();
+            scanQueue.Clear ();
             state = State::Ready;
             patches::Plugins::UpdateStatus (2, true);
         }
@@ -266,7 +280,7 @@ namespace Qr {
     }
 
     bool
-    Commit (std::vector<uint8_t> &buffer) {
+    Commit (const uint8_t *data, const size_t size) {
         if (!emulateQr) {
             LogMessage (LogLevel::DEBUG, "[QR] Not emulate QR Scanner!");
             return false;
@@ -275,20 +289,31 @@ namespace Qr {
             LogMessage (LogLevel::DEBUG, "[QR] Not Ready to accept QRData!");
             return false;
         }
-        if (buffer.size () == 0) {
+        if (size == 0) {
             LogMessage (LogLevel::ERROR, "[QR] Not an effective code, length: 0");
             return false;
         }
-        if (scanQueue.empty() || scanQueue.back() != buffer) {
-            std::vector<uint8_t> scanData = {};
-            for (uint8_t byte_data : buffer) 
-                scanData.push_back (byte_data);
-            scanQueue.push (scanData);
+        if (size > MaxQrSize) {
+            LogMessage (LogLevel::ERROR, "[QR] Not an effective code, length: {} max: {}", size, MaxQrSize);
+            return false;
+        }
+        if (scanQueue.Empty () || scanQueue.Back ().size != size || memcmp (scanQueue.Back ().data, data, size) != 0) {
+            QrScan scanData = {size};
+            memcpy (scanData.data, data, size);
+            if (!scanQueue.Push (scanData)) {
+                LogMessage (LogLevel::WARN, "[QR] Scan queue is full, dropped scan ({} dropped so far)", scanQueue.Overflows ());
+                return false;
+            }
         }
         if (state == State::Ready) state = State::CopyWait;
         return true;
     }
 
+    bool
+    Commit (std::vector<uint8_t> &buffer) {
+        return Commit (buffer.data (), buffer.size ());
+    }
+
     bool
     CommitLogin (std::string accessCode) {
         if (!emulateQr) {
@@ -312,13 +337,10 @@ namespace Qr {
             } else {
                 void *plugin = patches::Plugins::CheckQr ();
                 if (plugin) {
-                    uint8_t *space = (uint8_t *)calloc (600, sizeof (uint8_t));
-                    size_t size = patches::Plugins::GetQr (plugin, 600, space);
-                    if (size > 0) {
-                        std::vector<uint8_t> data = {};
-                        for (size_t i = 0; i < size; i ++) data.push_back (space[i]);
-                        patches::Scanner::Qr::Commit (data);
-                    }
+                    static uint8_t space[MaxQrSize];
+                    memset (space, 0, sizeof (space));
+                    const size_t size = patches::Plugins::GetQr (plugin, MaxQrSize, space);
+                    if (size > 0) patches::Scanner::Qr::Commit (space, size);
                 }
             }
         }
@@ -462,8 +484,11 @@ namespace Qr {
     }
 }
 
+ProfileSite updateSite ("Scanner::Update");
+
 void
 Update() {
+    PROFILE_SCOPE (updateSite);
     patches::Scanner::Card::Update ();
     patches::Scanner::Qr::Update ();
 }
@@ -28,9 +28,13 @@ FUNCTION_PTR (void, lua_pushboolean, PROC_ADDRESS ("lua51.dll", "lua_pushboolean
 FUNCTION_PTR (const char *, lua_pushstring, PROC_ADDRESS ("lua51.dll", "lua_pushstring"), i64, const char *);
 FUNCTION_PTR (i32, lua_toboolean, PROC_ADDRESS ("lua51.dll", "lua_toboolean"), i64, i32);
 FUNCTION_PTR (const char *, lua_tolstring, PROC_ADDRESS ("lua51.dll", "lua_tolstring"), u64, i32, size_t *);
+FUNCTION_PTR (i32, lua_type, PROC_ADDRESS ("lua51.dll", "lua_type"), i64, i32);
+FUNCTION_PTR (double, lua_tonumber, PROC_ADDRESS ("lua51.dll", "lua_tonumber"), i64, i32);
 FUNCTION_PTR (i32, lua_pcall, PROC_ADDRESS ("lua51.dll", "lua_pcall"), i64, i32, i32, i32);
 FUNCTION_PTR (i32, luaL_loadstring, PROC_ADDRESS ("lua51.dll", "luaL_loadstring"), i64, const char *);
 #define LUA_MULTRET         (-1)
+#define LUA_TNUMBER         3
+#define LUA_TSTRING         4
 #define luaL_dostring(L, s) (luaL_loadstring (L, s) || lua_pcall (L, 0, LUA_MULTRET, 0))
 
 FUNCTION_PTR (u64, RefTestModeMain, ASLR (0x1400337C0), u64);
@@ -296,8 +300,19 @@ FixToneName (const std::string &bankName, std::string toneName) {
 }
 
 size_t commonSize = 0;
+
+// Bank or tone name for TRACE, lua_tolstring would convert a number on the stack into a string in place
+std::string
+SoundName (const i64 a1, const i32 index) {
+    switch (lua_type (a1, index)) {
+    case LUA_TSTRING: return lua_tolstring (a1, index, nullptr);
+    case LUA_TNUMBER: return std::format ("{}", lua_tonumber (a1, index));
+    default: return "(none)";
+    }
+}
+
 HOOK (i64, PlaySound, ASLR (0x1404C6DC0), i64 a1) {
-    LogMessage (LogLevel::HOOKS, "PlaySound was called");
+    TRACE ("PlaySound was called, bank {} tone {}", SoundName (a1, -3), SoundName (a1, -2));
     if (enableSwitchVoice && language != 0) {
         const std::string bankName (lua_tolstring (a1, -3, &commonSize));
         if (bankName[0] == 'v') {
@@ -309,7 +324,7 @@ HOOK (i64, PlaySound, ASLR (0x1404C6DC0), i64 a1) {
 }
 
 HOOK (i64, PlaySoundMulti, ASLR (0x1404C6D60), i64 a1) {
-    LogMessage (LogLevel::HOOKS, "PlaySoundMulti was called");
+    TRACE ("PlaySoundMulti was called, bank {} tone {}", SoundName (a1, -3), SoundName (a1, -2));
     if (enableSwitchVoice && language != 0) {
         const std::string bankName (const_cast<char *> (lua_tolstring (a1, -3, &commonSize)));
         if (bankName[0] == 'v') {
@@ -331,7 +346,7 @@ FixToneNameEnso (u64 *Src, const std::string &bankName) {
 }
 
 HOOK (bool, PlaySoundEnso, ASLR (0x1404ED590), u64 *a1, u64 *a2, i64 a3) {
-    LogMessage (LogLevel::HOOKS, "PlaySoundEnso was called");
+    TRACE ("PlaySoundEnso was called");
     if (enableSwitchVoice && language != 0) {
         const std::string bankName = a1[3] > 0x10 ? std::string (*reinterpret_cast<char **> (a1)) : std::string (reinterpret_cast<char *> (a1));
         if (bankName[0] == 'v') a2 = FixToneNameEnso (a2, bankName);
@@ -340,7 +355,7 @@ HOOK (bool, PlaySoundEnso, ASLR (0x1404ED590), u64 *a1, u64 *a2, i64 a3) {
 }
 
 HOOK (bool, PlaySoundSpecial, ASLR (0x1404ED230), u64 *a1, u64 *a2) {
-    LogMessage (LogLevel::HOOKS, "PlaySoundSpecial was called");
+    TRACE ("PlaySoundSpecial was called");
     if (enableSwitchVoice && language != 0) {
         const std::string bankName = a1[3] > 0x10 ? std::string (*reinterpret_cast<char **> (a1)) : std::string (reinterpret_cast<char *> (a1));
         if (bankName[0] == 'v') a2 = FixToneNameEnso (a2, bankName);
@@ -350,9 +365,9 @@ HOOK (bool, PlaySoundSpecial, ASLR (0x1404ED230), u64 *a1, u64 *a2) {
 
 int loaded_fail_count = 0;
 HOOK (i64, LoadedBankAll, ASLR (0x1404C69F0), i64 a1) {
-    LogMessage (LogLevel::HOOKS, "LoadedBankAll was called");
     originalLoadedBankAll (a1);
     const auto result = lua_toboolean (a1, -1);
+    TRACE ("LoadedBankAll was called, loaded {} after {} failures", result, loaded_fail_count);
     lua_settop (a1, 0);
     if (result) {
         loaded_fail_count = 0;
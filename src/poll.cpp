@@ -1,6 +1,13 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <atomic>
+#include <memory>
+#include "input.h"
 #include "poll.h"
 
 extern bool jpLayout;
+extern bool keyboardEvents;
 
 struct KeyCodePair {
     const char *string;
@@ -302,20 +309,209 @@ struct {
 struct MouseState {
     POINT Position;
     POINT RelativePosition;
-    bool ScrolledUp;
-    bool ScrolledDown;
 } currentMouseState, lastMouseState;
 
-bool currentKeyboardState[0xFF];
-bool lastKeyboardState[0xFF];
+// Tapped and released edges are derived once per UpdatePoll
+InputState inputState;
+InputBits &currentInput  = inputState.current;
+InputBits &lastInput     = inputState.last;
+InputBits &tappedInput   = inputState.tapped;
+InputBits &releasedInput = inputState.released;
 
-bool currentControllerButtonsState[SDL_CONTROLLER_BUTTON_MAX];
-bool lastControllerButtonsState[SDL_CONTROLLER_BUTTON_MAX];
-SDLAxisState currentControllerAxisState;
-SDLAxisState lastControllerAxisState;
+std::array<SDLAxisState, MaxControllers> &currentControllerAxisState = inputState.axis;
+std::array<SDLAxisState, MaxControllers> &lastControllerAxisState    = inputState.lastAxis;
+
+static bool
+TestBit (const u64 *bits, const u32 index) {
+    return (bits[index / 64] >> (index % 64)) & 1;
+}
 
 SDL_Window *window;
-SDL_GameController *controllers[255];
+AxisMotionHandler axisMotionHandler = nullptr;
+
+// Polls each watched key once per Read, the cost follows the number of bound keys
+class AsyncKeyBackend final : public InputBackend {
+public:
+    void Watch (const u64 (&keys)[4]) override { memcpy (this->watched, keys, sizeof (this->watched)); }
+
+    void
+    Read (u64 (&keys)[4]) override {
+        for (u32 word = 0; word < 4; word++) {
+            keys[word] = 0;
+            for (u64 bits = this->watched[word]; bits; bits &= bits - 1) {
+                const u32 bit = std::countr_zero (bits);
+                if (GetAsyncKeyState (static_cast<int> (word * 64 + bit)) != 0) keys[word] |= 1ull << bit;
+            }
+        }
+    }
+
+private:
+    u64 watched[4] = {};
+};
+
+// Tracks watched keys from the window's key messages as they arrive, Read only loads the bits
+class MessageKeyBackend final : public InputBackend {
+public:
+    explicit MessageKeyBackend (const HWND windowHandle) : windowHandle (windowHandle) {
+        instance       = this;
+        this->original = reinterpret_cast<WNDPROC> (SetWindowLongPtrW (windowHandle, GWLP_WNDPROC, reinterpret_cast<LONG_PTR> (WindowProc)));
+    }
+    ~MessageKeyBackend () override {
+        SetWindowLongPtrW (this->windowHandle, GWLP_WNDPROC, reinterpret_cast<LONG_PTR> (this->original));
+        instance = nullptr;
+    }
+
+    void
+    Watch (const u64 (&keys)[4]) override {
+        for (int i = 0; i < 4; i++)
+            this->watched[i].store (keys[i], std::memory_order_relaxed);
+    }
+
+    void
+    Read (u64 (&keys)[4]) override {
+        for (int i = 0; i < 4; i++)
+            keys[i] = this->down[i].load (std::memory_order_relaxed) | this->pressed[i].exchange (0, std::memory_order_relaxed);
+    }
+
+private:
+    static LRESULT CALLBACK
+    WindowProc (const HWND hwnd, const UINT message, const WPARAM wParam, const LPARAM lParam) {
+        MessageKeyBackend *self = instance;
+        switch (message) {
+        case WM_KEYDOWN:
+        case WM_SYSKEYDOWN: self->Set (KeyOf (wParam, lParam), true); break;
+        case WM_KEYUP:
+        case WM_SYSKEYUP: self->Set (KeyOf (wParam, lParam), false); break;
+        case WM_KILLFOCUS:
+            for (auto &word : self->down)
+                word.store (0, std::memory_order_relaxed);
+            break;
+        default: break;
+        }
+        return CallWindowProcW (self->original, hwnd, message, wParam, lParam);
+    }
+
+    // An active IME reports keys as VK_PROCESSKEY, the scan code still names the physical key
+    static u8
+    KeyOf (const WPARAM wParam, const LPARAM lParam) {
+        if (wParam != VK_PROCESSKEY) return static_cast<u8> (wParam);
+        UINT scanCode = (lParam >> 16) & 0xFF;
+        if (lParam & (1 << 24)) scanCode |= 0xE000;
+        // Window messages name modifiers without their side
+        switch (const UINT key = MapVirtualKeyW (scanCode, MAPVK_VSC_TO_VK_EX)) {
+        case VK_LSHIFT:
+        case VK_RSHIFT: return VK_SHIFT;
+        case VK_LCONTROL:
+        case VK_RCONTROL: return VK_CONTROL;
+        case VK_LMENU:
+        case VK_RMENU: return VK_MENU;
+        default: return static_cast<u8> (key);
+        }
+    }
+
+    void
+    Set (const u8 key, const bool isDown) {
+        const u64 bit = 1ull << (key % 64);
+        if (!(this->watched[key / 64].load (std::memory_order_relaxed) & bit)) return;
+        if (isDown) {
+            this->down[key / 64].fetch_or (bit, std::memory_order_relaxed);
+            this->pressed[key / 64].fetch_or (bit, std::memory_order_relaxed);
+        } else {
+            this->down[key / 64].fetch_and (~bit, std::memory_order_relaxed);
+        }
+    }
+
+    static inline MessageKeyBackend *instance = nullptr;
+    HWND windowHandle;
+    WNDPROC original;
+    std::atomic<u64> watched[4] = {};
+    std::atomic<u64> down[4]    = {};
+    std::atomic<u64> pressed[4] = {};
+};
+
+u64 watchedKeys[4] = {};
+std::unique_ptr<InputBackend> keyboardBackend;
+
+void
+SetInputBackend (std::unique_ptr<InputBackend> backend) {
+    keyboardBackend = std::move (backend);
+    if (keyboardBackend) keyboardBackend->Watch (watchedKeys);
+}
+
+// Connected controllers by player slot, each keeps its own state in currentInput and currentControllerAxisState
+struct ControllerSlot {
+    SDL_GameController *controller;
+    SDL_JoystickID id;
+} controllers[MaxControllers];
+std::vector<std::string> pinnedDevices;
+
+Keybindings *const *logicalBindings = nullptr;
+size_t logicalBindingCount          = 0;
+LogicalInputChannel logicalInput;
+
+static int
+FindControllerSlot (const SDL_JoystickID id) {
+    for (int slot = 0; slot < MaxControllers; slot++)
+        if (controllers[slot].controller && controllers[slot].id == id) return slot;
+    return AnySlot;
+}
+
+static void
+AttachController (const int deviceIndex) {
+    if (!SDL_IsGameController (deviceIndex)) return;
+    // Devices opened by InitializePoll are announced again by SDL_CONTROLLERDEVICEADDED
+    if (FindControllerSlot (SDL_JoystickGetDeviceInstanceID (deviceIndex)) != AnySlot) return;
+
+    const char *name = SDL_GameControllerNameForIndex (deviceIndex);
+    char guid[33];
+    SDL_JoystickGetGUIDString (SDL_JoystickGetDeviceGUID (deviceIndex), guid, sizeof (guid));
+
+    // A pinned slot waits for its device, other devices take the first unpinned free slot and only then any free slot
+    int slot = AnySlot;
+    for (size_t i = 0; i < pinnedDevices.size () && i < MaxControllers && slot == AnySlot; i++)
+        if (!controllers[i].controller && (pinnedDevices[i] == guid || (name && pinnedDevices[i] == name))) slot = static_cast<int> (i);
+    for (int i = 0; i < MaxControllers && slot == AnySlot; i++)
+        if (!controllers[i].controller && (static_cast<size_t> (i) >= pinnedDevices.size () || pinnedDevices[i].empty ())) slot = i;
+    for (int i = 0; i < MaxControllers && slot == AnySlot; i++)
+        if (!controllers[i].controller) slot = i;
+    if (slot == AnySlot) {
+        LogMessage (LogLevel::WARN, "No free controller slot for {}, only {} controllers are supported", name ? name : guid, MaxControllers);
+        return;
+    }
+
+    SDL_GameController *controller = SDL_GameControllerOpen (deviceIndex);
+    if (!controller) {
+        LogMessage (LogLevel::ERROR, std::string ("Could not open gamecontroller ") + (name ? name : guid) + ": " + SDL_GetError ());
+        return;
+    }
+    SDL_GameControllerSetPlayerIndex (controller, slot);
+
+    // The input thread walks controllers under the same lock
+    SDL_LockJoysticks ();
+    controllers[slot] = {controller, SDL_JoystickInstanceID (SDL_GameControllerGetJoystick (controller))};
+    SDL_UnlockJoysticks ();
+    LogMessage (LogLevel::INFO, "Controller {} ({}) connected to slot {}", name ? name : "unknown", guid, slot + 1);
+}
+
+static void
+DetachController (const SDL_JoystickID id) {
+    const int slot = FindControllerSlot (id);
+    if (slot == AnySlot) return;
+
+    SDL_LockJoysticks ();
+    SDL_GameControllerClose (controllers[slot].controller);
+    controllers[slot] = {};
+    SDL_UnlockJoysticks ();
+
+    currentInput.buttons[slot]       = 0;
+    currentControllerAxisState[slot] = {};
+    LogMessage (LogLevel::INFO, "Controller in slot {} disconnected", slot + 1);
+}
+
+void
+SetControllerSlots (const std::vector<std::string> &devices) {
+    pinnedDevices = devices;
+}
 
 void
 SetKeyboardButtons () {
@@ -329,6 +525,7 @@ SetConfigValue (const toml_table_t *table, const char *key, Keybindings *key_bin
     const toml_array_t *array = toml_array_in (table, key);
     if (!array) {
         LogMessage (LogLevel::WARN, std::string (key) + ": Cannot find array");
+        CompileKeybindings (key_bind);
         return;
     }
 
@@ -355,7 +552,8 @@ SetConfigValue (const toml_table_t *table, const char *key, Keybindings *key_bin
         case button: {
             for (int i = 0; i < std::size (key_bind->buttons); i++) {
                 if (key_bind->buttons[i] == SDL_CONTROLLER_BUTTON_INVALID) {
-                    key_bind->buttons[i] = value.button;
+                    key_bind->buttons[i]     = value.button;
+                    key_bind->buttonSlots[i] = value.slot;
                     break;
                 }
             }
@@ -364,10 +562,12 @@ SetConfigValue (const toml_table_t *table, const char *key, Keybindings *key_bin
         case axis: {
             for (int i = 0; i < std::size (key_bind->axis); i++) {
                 if (key_bind->axis[i] == 0) {
-                    key_bind->axis[i] = value.axis;
+                    key_bind->axis[i]      = value.axis;
+                    key_bind->axisSlots[i] = value.slot;
                     break;
                 }
             }
+            break;
         }
         case scroll: {
             for (int i = 0; i < std::size (key_bind->scroll); i++) {
@@ -381,6 +581,38 @@ SetConfigValue (const toml_table_t *table, const char *key, Keybindings *key_bin
         default: break;
         }
     }
+
+    CompileKeybindings (key_bind);
+}
+
+void
+CompileKeybindings (Keybindings *key_bind) {
+    key_bind->compiled = CompileBindings (*key_bind, SDL_CONTROLLER_BUTTON_MAX);
+    for (size_t i = 0; i < std::size (watchedKeys); i++)
+        watchedKeys[i] |= key_bind->compiled.keyboard[i];
+    if (keyboardBackend) keyboardBackend->Watch (watchedKeys);
+}
+
+// Evaluates every logical binding once, getters then read single bits instead of rebuilding the state per call
+static void
+PublishLogicalInput () {
+    u32 down = 0, tapped = 0, released = 0;
+    for (size_t i = 0; i < logicalBindingCount; i++) {
+        const auto [Down, Released, Tapped] = GetInternalButtonState (*logicalBindings[i]);
+        // Partially pressed axes do not count as down, matching the truncation switch inputs always had
+        down |= static_cast<u32> (Down >= 1.0f) << i;
+        tapped |= static_cast<u32> (Tapped) << i;
+        released |= static_cast<u32> (Released) << i;
+    }
+    logicalInput.Publish (down, tapped, released);
+}
+
+// Installed after SDL so the window procedure chain ends in SDL's and then the game's
+static void
+InstallKeyboardBackend (const HWND windowHandle) {
+    if (keyboardBackend) return;
+    if (keyboardEvents && windowHandle) SetInputBackend (std::make_unique<MessageKeyBackend> (windowHandle));
+    else SetInputBackend (std::make_unique<AsyncKeyBackend> ());
 }
 
 bool
@@ -400,6 +632,8 @@ InitializePoll (const HWND windowHandle) {
             LogMessage (LogLevel::ERROR,
                         std::string ("SDL_Init (SDL_INIT_JOYSTICK | SDL_INIT_HAPTIC | SDL_INIT_GAMECONTROLLER | SDL_INIT_EVENTS | SDL_INIT_VIDEO): ")
                             + SDL_GetError ());
+            // The keyboard still works without SDL
+            InstallKeyboardBackend (windowHandle);
             return false;
         }
     }
@@ -410,119 +644,141 @@ InitializePoll (const HWND windowHandle) {
     SDL_GameControllerEventState (SDL_ENABLE);
     SDL_JoystickEventState (SDL_ENABLE);
 
-    for (int i = 0; i < SDL_NumJoysticks (); i++) {
-        if (!SDL_IsGameController (i)) continue;
-
-        SDL_GameController *controller = SDL_GameControllerOpen (i);
-        if (!controller) {
-            LogMessage (LogLevel::WARN, std::string ("Could not open gamecontroller ") + SDL_GameControllerNameForIndex (i) + ": " + SDL_GetError ());
-            continue;
-        }
-        controllers[i] = controller;
-    }
+    for (int i = 0; i < SDL_NumJoysticks (); i++)
+        AttachController (i);
 
     window = SDL_CreateWindowFrom (windowHandle);
     if (window == nullptr) LogMessage (LogLevel::ERROR, std::string ("SDL_CreateWindowFrom (windowHandle): ") + SDL_GetError ());
+
+    InstallKeyboardBackend (windowHandle);
     atexit (DisposePoll);
 
     return hasRumble;
 }
 
+// Where an axis event lands, indexed by SDL axis and sign (negative, dead zone, positive)
+struct AxisDecode {
+    SDLAxis target;
+    float scale;
+    SDLAxis opposite;
+};
+
+constexpr auto
+MakeAxisDecode (const SDLAxis positive, const SDLAxis negative) {
+    return std::array<AxisDecode, 3>{{
+        {negative, negative == SDL_AXIS_NULL ? 0.0f : -1.0f / 32768, positive},
+        {positive, 0.0f, negative},
+        {positive, 1.0f / 32767, negative},
+    }};
+}
+
+constexpr std::array<AxisDecode, 3> AxisDecodeTable[SDL_CONTROLLER_AXIS_MAX] = {
+    MakeAxisDecode (SDL_AXIS_LEFT_RIGHT, SDL_AXIS_LEFT_LEFT),   MakeAxisDecode (SDL_AXIS_LEFT_DOWN, SDL_AXIS_LEFT_UP),
+    MakeAxisDecode (SDL_AXIS_RIGHT_RIGHT, SDL_AXIS_RIGHT_LEFT), MakeAxisDecode (SDL_AXIS_RIGHT_DOWN, SDL_AXIS_RIGHT_UP),
+    MakeAxisDecode (SDL_AXIS_LTRIGGER_DOWN, SDL_AXIS_NULL),     MakeAxisDecode (SDL_AXIS_RTRIGGER_DOWN, SDL_AXIS_NULL),
+};
+
+static void
+DecodeAxisMotion (const SDL_ControllerAxisEvent &motion) {
+    const int slot = FindControllerSlot (motion.which);
+    if (slot == AnySlot || motion.axis >= SDL_CONTROLLER_AXIS_MAX) return;
+
+    const auto &[target, scale, opposite] = AxisDecodeTable[motion.axis][(motion.value > 1) - (motion.value < -1) + 1];
+    float *values                         = currentControllerAxisState[slot].values;
+    values[target]                        = motion.value * scale;
+    values[opposite]                      = 0;
+
+    if (axisMotionHandler) {
+        const u64 timestamp = static_cast<u64> (motion.timestamp) * 1000;
+        if (target != SDL_AXIS_NULL) axisMotionHandler (slot, target, values[target], timestamp);
+        if (opposite != SDL_AXIS_NULL) axisMotionHandler (slot, opposite, 0, timestamp);
+    }
+}
+
+static void
+ProcessEvent (const SDL_Event &event) {
+    switch (event.type) {
+    // Added events carry a device index, every other controller event carries the joystick instance id
+    case SDL_CONTROLLERDEVICEADDED: AttachController (event.cdevice.which); break;
+    case SDL_CONTROLLERDEVICEREMOVED: DetachController (event.cdevice.which); break;
+    case SDL_MOUSEWHEEL:
+        if (event.wheel.y > 0) currentInput.scroll |= 1ull << MOUSE_SCROLL_UP;
+        else if (event.wheel.y < 0) currentInput.scroll |= 1ull << MOUSE_SCROLL_DOWN;
+        break;
+    case SDL_CONTROLLERBUTTONUP:
+    case SDL_CONTROLLERBUTTONDOWN:
+        if (const int slot = FindControllerSlot (event.cbutton.which); slot != AnySlot && event.cbutton.button < SDL_CONTROLLER_BUTTON_MAX) {
+            if (event.cbutton.state) currentInput.buttons[slot] |= 1ull << event.cbutton.button;
+            else currentInput.buttons[slot] &= ~(1ull << event.cbutton.button);
+        }
+        break;
+    case SDL_CONTROLLERAXISMOTION: DecodeAxisMotion (event.caxis); break;
+    default: break;
+    }
+}
+
 void
 UpdatePoll (const HWND windowHandle) {
-    if (windowHandle == nullptr || GetForegroundWindow () != windowHandle) return;
-
-    memcpy (lastKeyboardState, currentKeyboardState, 255);
-    memcpy (lastControllerButtonsState, currentControllerButtonsState, 21);
-    lastMouseState          = currentMouseState;
-    lastControllerAxisState = currentControllerAxisState;
+    if (windowHandle == nullptr || GetForegroundWindow () != windowHandle) {
+        // Held bindings stay down, but edges from the last focused frame must not repeat
+        const LogicalInputFrame frame = logicalInput.Load ();
+        if (frame.tapped || frame.released) logicalInput.Publish (frame.down, 0, 0);
+        return;
+    }
 
-    for (u8 i = 0; i < 0xFF; i++)
-        currentKeyboardState[i] = GetAsyncKeyState (i) != 0;
+    BeginInputFrame (inputState);
+    lastMouseState = currentMouseState;
 
-    currentMouseState.ScrolledUp   = false;
-    currentMouseState.ScrolledDown = false;
+    if (keyboardBackend) keyboardBackend->Read (currentInput.keyboard);
 
     GetCursorPos (&currentMouseState.Position);
     ScreenToClient (windowHandle, &currentMouseState.Position);
 
-    SDL_Event event;
-    SDL_GameController *controller;
-    while (SDL_PollEvent (&event) != 0) {
-        switch (event.type) {
-        case SDL_CONTROLLERDEVICEADDED:
-            if (!SDL_IsGameController (event.cdevice.which)) break;
-
-            controller = SDL_GameControllerOpen (event.cdevice.which);
-            if (!controller) {
-                LogMessage (LogLevel::ERROR, std::string ("Could not open gamecontroller ") + SDL_GameControllerNameForIndex (event.cdevice.which)
-                                                 + ": " + SDL_GetError ());
-                continue;
-            }
-            controllers[event.cdevice.which] = controller;
-            break;
-        case SDL_CONTROLLERDEVICEREMOVED:
-            if (!SDL_IsGameController (event.cdevice.which)) break;
-            SDL_GameControllerClose (controllers[event.cdevice.which]);
-            break;
-        case SDL_MOUSEWHEEL:
-            if (event.wheel.y > 0) currentMouseState.ScrolledUp = true;
-            else if (event.wheel.y < 0) currentMouseState.ScrolledDown = true;
-            break;
-        case SDL_CONTROLLERBUTTONUP:
-        case SDL_CONTROLLERBUTTONDOWN: currentControllerButtonsState[event.cbutton.button] = event.cbutton.state; break;
-        case SDL_CONTROLLERAXISMOTION:
-            if (event.caxis.value > 1) {
-                switch (event.caxis.axis) {
-                case SDL_CONTROLLER_AXIS_LEFTX: currentControllerAxisState.LeftRight = static_cast<float> (event.caxis.value) / 32767; break;
-                case SDL_CONTROLLER_AXIS_LEFTY: currentControllerAxisState.LeftDown = static_cast<float> (event.caxis.value) / 32767; break;
-                case SDL_CONTROLLER_AXIS_RIGHTX: currentControllerAxisState.RightRight = static_cast<float> (event.caxis.value) / 32767; break;
-                case SDL_CONTROLLER_AXIS_RIGHTY: currentControllerAxisState.RightDown = static_cast<float> (event.caxis.value) / 32767; break;
-                case SDL_CONTROLLER_AXIS_TRIGGERLEFT: currentControllerAxisState.LTriggerDown = static_cast<float> (event.caxis.value) / 32767; break;
-                case SDL_CONTROLLER_AXIS_TRIGGERRIGHT:
-                    currentControllerAxisState.RTriggerDown = static_cast<float> (event.caxis.value) / 32767;
-                    break;
-                default: break;
-                }
-            } else if (event.caxis.value < -1) {
-                switch (event.caxis.axis) {
-                case SDL_CONTROLLER_AXIS_LEFTX: currentControllerAxisState.LeftLeft = static_cast<float> (event.caxis.value) / -32768; break;
-                case SDL_CONTROLLER_AXIS_LEFTY: currentControllerAxisState.LeftUp = static_cast<float> (event.caxis.value) / -32768; break;
-                case SDL_CONTROLLER_AXIS_RIGHTX: currentControllerAxisState.RightLeft = static_cast<float> (event.caxis.value) / -32768; break;
-                case SDL_CONTROLLER_AXIS_RIGHTY: currentControllerAxisState.RightUp = static_cast<float> (event.caxis.value) / -32768; break;
-                default: break;
-                }
-            } else {
-                switch (event.caxis.axis) {
-                case SDL_CONTROLLER_AXIS_LEFTX:
-                    currentControllerAxisState.LeftRight = 0;
-                    currentControllerAxisState.LeftLeft  = 0;
-                    break;
-                case SDL_CONTROLLER_AXIS_LEFTY:
-                    currentControllerAxisState.LeftDown = 0;
-                    currentControllerAxisState.LeftUp   = 0;
-                    break;
-                case SDL_CONTROLLER_AXIS_RIGHTX:
-                    currentControllerAxisState.RightRight = 0;
-                    currentControllerAxisState.RightLeft  = 0;
-                    break;
-                case SDL_CONTROLLER_AXIS_RIGHTY:
-                    currentControllerAxisState.RightDown = 0;
-                    currentControllerAxisState.RightUp   = 0;
-                    break;
-                case SDL_CONTROLLER_AXIS_TRIGGERLEFT: currentControllerAxisState.LTriggerDown = 0; break;
-                case SDL_CONTROLLER_AXIS_TRIGGERRIGHT: currentControllerAxisState.RTriggerDown = 0; break;
-                default: break;
-                }
-            }
-            break;
-        default: break;
-        }
+    // Drain the queue in batches, high polling rate controllers can queue hundreds of axis events per frame
+    static SDL_Event events[128];
+    SDL_PumpEvents ();
+    for (;;) {
+        const int count = SDL_PeepEvents (events, static_cast<int> (std::size (events)), SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT);
+        for (int i = 0; i < count; i++)
+            ProcessEvent (events[i]);
+        if (count < static_cast<int> (std::size (events))) break;
     }
+
+    UpdateInputEdges (inputState);
+    PublishLogicalInput ();
+}
+
+void
+SetAxisMotionHandler (const AxisMotionHandler handler) {
+    axisMotionHandler = handler;
+}
+
+void
+CaptureSnapshot (InputSnapshot &snapshot) {
+    SaveSnapshot (inputState, snapshot);
+}
+
+// Stands in for UpdatePoll, so everything reading the poll state sees the recorded frame
+void
+ApplySnapshot (const InputSnapshot &snapshot) {
+    LoadSnapshot (inputState, snapshot);
+    PublishLogicalInput ();
+}
+
+void
+SetLogicalBindings (Keybindings *const *bindings, const size_t count) {
+    logicalBindings     = bindings;
+    logicalBindingCount = std::min (count, MaxLogicalBindings);
+}
+
+LogicalInputFrame
+GetLogicalInput () {
+    return logicalInput.Load ();
 }
 
 void
 DisposePoll () {
+    keyboardBackend.reset ();
     SDL_DestroyWindow (window);
     SDL_Quit ();
 }
@@ -530,6 +786,11 @@ DisposePoll () {
 ConfigValue
 StringToConfigEnum (const char *value) {
     ConfigValue rval{};
+    // "2:SDL_A" limits a controller binding to the controller in slot 2
+    if (value[0] >= '1' && value[0] <= '0' + MaxControllers && value[1] == ':') {
+        rval.slot = value[0] - '0';
+        value += 2;
+    }
     for (size_t i = 0; i < ConfigKeyboardButtonsCount; ++i)
         if (!strcmp (value, ConfigKeyboardButtons[i].string)) {
             rval.type    = keycode;
@@ -561,40 +822,54 @@ StringToConfigEnum (const char *value) {
 
 InternalButtonState
 GetInternalButtonState (const Keybindings &bindings) {
-    InternalButtonState buttons = {};
+    return EvaluateBindings (bindings.compiled, inputState);
+}
 
-    for (size_t i = 0; i < ConfigKeyboardButtonsCount; i++) {
-        if (bindings.keycodes[i] == 0) continue;
-        if (KeyboardIsReleased (bindings.keycodes[i])) buttons.Released = true;
-        if (KeyboardIsDown (bindings.keycodes[i])) buttons.Down = 1;
-        if (KeyboardIsTapped (bindings.keycodes[i])) buttons.Tapped = true;
-    }
-    for (size_t i = 0; i < std::size (ConfigControllerButtons); i++) {
-        if (bindings.buttons[i] == SDL_CONTROLLER_BUTTON_INVALID) continue;
-        if (ControllerButtonIsReleased (bindings.buttons[i])) buttons.Released = true;
-        if (ControllerButtonIsDown (bindings.buttons[i])) buttons.Down = 1;
-        if (ControllerButtonIsTapped (bindings.buttons[i])) buttons.Tapped = true;
-    }
-    for (size_t i = 0; i < std::size (ConfigControllerAXIS); i++) {
-        if (bindings.axis[i] == 0) continue;
-        if (const float val = ControllerAxisIsReleased (bindings.axis[i]))
-            buttons.Released = static_cast<bool> (val);                                                            // NOLINT(*-narrowing-conversions)
-        if (const float val = ControllerAxisIsDown (bindings.axis[i])) buttons.Down = val;                         // NOLINT(*-narrowing-conversions)
-        if (const float val = ControllerAxisIsTapped (bindings.axis[i])) buttons.Tapped = static_cast<bool> (val); // NOLINT(*-narrowing-conversions)
-    }
-    for (const auto i : bindings.scroll) {
-        if (i == 0) continue;
-        if (GetMouseScrollIsReleased (i)) buttons.Released = true;
-        if (GetMouseScrollIsDown (i)) buttons.Down = 1;
-        if (GetMouseScrollIsTapped (i)) buttons.Tapped = true;
-    }
 
-    return buttons;
+// Source axis and direction for each SDLAxis, used when reading controllers directly
+struct {
+    SDL_GameControllerAxis axis;
+    int direction;
+} SDLAxisSources[SDL_AXIS_MAX] = {
+    {SDL_CONTROLLER_AXIS_INVALID, 0},   {SDL_CONTROLLER_AXIS_LEFTX, -1},       {SDL_CONTROLLER_AXIS_LEFTX, 1},
+    {SDL_CONTROLLER_AXIS_LEFTY, -1},    {SDL_CONTROLLER_AXIS_LEFTY, 1},        {SDL_CONTROLLER_AXIS_RIGHTX, -1},
+    {SDL_CONTROLLER_AXIS_RIGHTX, 1},    {SDL_CONTROLLER_AXIS_RIGHTY, -1},      {SDL_CONTROLLER_AXIS_RIGHTY, 1},
+    {SDL_CONTROLLER_AXIS_TRIGGERLEFT, 1}, {SDL_CONTROLLER_AXIS_TRIGGERRIGHT, 1},
+};
+
+/* *
+ * Reads the live device state of a binding, bypassing the per frame snapshot.
+ * Safe to call off the render thread, controller state must be refreshed with SDL_GameControllerUpdate first,
+ * both under SDL_LockJoysticks so SDL_PumpEvents on the game thread cannot update the joysticks in between.
+ */
+bool
+SampleButtonDown (const Keybindings &bindings) {
+    const CompiledBindings &compiled = bindings.compiled;
+
+    for (u32 word = 0; word < std::size (compiled.keyboard); word++)
+        for (u64 bits = compiled.keyboard[word]; bits; bits &= bits - 1)
+            if (GetAsyncKeyState (static_cast<int> (word * 64 + std::countr_zero (bits))) & 0x8000) return true;
+
+    bool down = false;
+    SDL_LockJoysticks ();
+    for (u8 slot = 0; slot < MaxControllers && !down; slot++) {
+        SDL_GameController *controller = controllers[slot].controller;
+        if (!controller) continue;
+        for (u32 bits = compiled.buttons[slot]; bits && !down; bits &= bits - 1)
+            down = SDL_GameControllerGetButton (controller, static_cast<SDL_GameControllerButton> (std::countr_zero (bits)));
+        for (u8 i = 0; i < compiled.axisCount && !down; i++) {
+            if (!(compiled.axis[i].slots & (1u << slot))) continue;
+            const auto &[axis, direction] = SDLAxisSources[compiled.axis[i].axis];
+            down = SDL_GameControllerGetAxis (controller, axis) * direction > 1;
+        }
+    }
+    SDL_UnlockJoysticks ();
+    return down;
 }
 
 void
 SetRumble (const int left, const int right, const int length) {
-    for (auto &controller : controllers) {
+    for (const auto &[controller, id] : controllers) {
         if (!controller || !SDL_GameControllerHasRumble (controller)) continue;
 
         SDL_GameControllerRumble (controller, left, right, length);
@@ -603,7 +878,7 @@ SetRumble (const int left, const int right, const int length) {
 
 bool
 KeyboardIsDown (const u8 keycode) {
-    return currentKeyboardState[keycode];
+    return TestBit (currentInput.keyboard, keycode);
 }
 
 bool
@@ -613,17 +888,17 @@ KeyboardIsUp (const u8 keycode) {
 
 bool
 KeyboardIsTapped (const u8 keycode) {
-    return KeyboardIsDown (keycode) && KeyboardWasUp (keycode);
+    return TestBit (tappedInput.keyboard, keycode);
 }
 
 bool
 KeyboardIsReleased (const u8 keycode) {
-    return KeyboardIsUp (keycode) && KeyboardWasDown (keycode);
+    return TestBit (releasedInput.keyboard, keycode);
 }
 
 bool
 KeyboardWasDown (const u8 keycode) {
-    return lastKeyboardState[keycode];
+    return TestBit (lastInput.keyboard, keycode);
 }
 
 bool
@@ -650,124 +925,107 @@ SetMousePosition (const POINT newPosition) {
 
 bool
 GetMouseScrollUp () {
-    return currentMouseState.ScrolledUp;
+    return TestBit (&currentInput.scroll, MOUSE_SCROLL_UP);
 }
 
 bool
 GetMouseScrollDown () {
-    return currentMouseState.ScrolledDown;
+    return TestBit (&currentInput.scroll, MOUSE_SCROLL_DOWN);
 }
 
 bool
 GetWasMouseScrollUp () {
-    return lastMouseState.ScrolledUp;
+    return TestBit (&lastInput.scroll, MOUSE_SCROLL_UP);
 }
 
 bool
 GetWasMouseScrollDown () {
-    return lastMouseState.ScrolledDown;
+    return TestBit (&lastInput.scroll, MOUSE_SCROLL_DOWN);
 }
 
 bool
 GetMouseScrollIsReleased (const Scroll scroll) {
-    if (scroll == MOUSE_SCROLL_UP) return !GetMouseScrollUp () && GetWasMouseScrollUp ();
-    return !GetMouseScrollDown () && GetWasMouseScrollDown ();
+    return TestBit (&releasedInput.scroll, scroll);
 }
 
 bool
 GetMouseScrollIsDown (const Scroll scroll) {
-    if (scroll == MOUSE_SCROLL_UP) return GetMouseScrollUp ();
-    return GetMouseScrollDown ();
+    return TestBit (&currentInput.scroll, scroll);
 }
 
 bool
 GetMouseScrollIsTapped (const Scroll scroll) {
-    if (scroll == MOUSE_SCROLL_UP) return GetMouseScrollUp () && !GetWasMouseScrollUp ();
-    return GetMouseScrollDown () && !GetWasMouseScrollDown ();
+    return TestBit (&tappedInput.scroll, scroll);
+}
+
+// Without a slot, a button counts as down when it is down on any controller
+static bool
+TestButton (const InputBits &bits, const SDL_GameControllerButton button, const int slot) {
+    if (button <= SDL_CONTROLLER_BUTTON_INVALID || button >= SDL_CONTROLLER_BUTTON_MAX) return false;
+    if (slot != AnySlot) return slot < MaxControllers && TestBit (&bits.buttons[slot], button);
+    for (const u64 &buttons : bits.buttons)
+        if (TestBit (&buttons, button)) return true;
+    return false;
 }
 
 bool
-ControllerButtonIsDown (const SDL_GameControllerButton button) {
-    return currentControllerButtonsState[button];
+ControllerButtonIsDown (const SDL_GameControllerButton button, const int slot) {
+    return TestButton (currentInput, button, slot);
 }
 
 bool
-ControllerButtonIsUp (const SDL_GameControllerButton button) {
-    return !ControllerButtonIsDown (button);
+ControllerButtonIsUp (const SDL_GameControllerButton button, const int slot) {
+    return !ControllerButtonIsDown (button, slot);
 }
 
 bool
-ControllerButtonWasDown (const SDL_GameControllerButton button) {
-    return lastControllerButtonsState[button];
+ControllerButtonWasDown (const SDL_GameControllerButton button, const int slot) {
+    return TestButton (lastInput, button, slot);
 }
 
 bool
-ControllerButtonWasUp (const SDL_GameControllerButton button) {
-    return !ControllerButtonWasDown (button);
+ControllerButtonWasUp (const SDL_GameControllerButton button, const int slot) {
+    return !ControllerButtonWasDown (button, slot);
 }
 
 bool
-ControllerButtonIsTapped (const SDL_GameControllerButton button) {
-    return ControllerButtonIsDown (button) && ControllerButtonWasUp (button);
+ControllerButtonIsTapped (const SDL_GameControllerButton button, const int slot) {
+    return TestButton (tappedInput, button, slot);
 }
 
 bool
-ControllerButtonIsReleased (const SDL_GameControllerButton button) {
-    return ControllerButtonIsUp (button) && ControllerButtonWasDown (button);
+ControllerButtonIsReleased (const SDL_GameControllerButton button, const int slot) {
+    return TestButton (releasedInput, button, slot);
 }
 
 float
-ControllerAxisIsDown (const SDLAxis axis) {
-    switch (axis) {
-    case SDL_AXIS_LEFT_LEFT: return currentControllerAxisState.LeftLeft;
-    case SDL_AXIS_LEFT_RIGHT: return currentControllerAxisState.LeftRight;
-    case SDL_AXIS_LEFT_UP: return currentControllerAxisState.LeftUp;
-    case SDL_AXIS_LEFT_DOWN: return currentControllerAxisState.LeftDown;
-    case SDL_AXIS_RIGHT_LEFT: return currentControllerAxisState.RightLeft;
-    case SDL_AXIS_RIGHT_RIGHT: return currentControllerAxisState.RightRight;
-    case SDL_AXIS_RIGHT_UP: return currentControllerAxisState.RightUp;
-    case SDL_AXIS_RIGHT_DOWN: return currentControllerAxisState.RightDown;
-    case SDL_AXIS_LTRIGGER_DOWN: return currentControllerAxisState.LTriggerDown;
-    case SDL_AXIS_RTRIGGER_DOWN: return currentControllerAxisState.RTriggerDown;
-    default: return false;
-    }
+ControllerAxisIsDown (const SDLAxis axis, const int slot) {
+    return AxisValue (currentControllerAxisState, axis, slot);
 }
 
 bool
-ControllerAxisIsUp (const SDLAxis axis) {
-    return !static_cast<bool> (ControllerAxisIsDown (axis));
+ControllerAxisIsUp (const SDLAxis axis, const int slot) {
+    return !static_cast<bool> (ControllerAxisIsDown (axis, slot));
 }
 
 float
-ControllerAxisWasDown (const SDLAxis axis) {
-    switch (axis) {
-    case SDL_AXIS_LEFT_LEFT: return lastControllerAxisState.LeftLeft;
-    case SDL_AXIS_LEFT_RIGHT: return lastControllerAxisState.LeftRight;
-    case SDL_AXIS_LEFT_UP: return lastControllerAxisState.LeftUp;
-    case SDL_AXIS_LEFT_DOWN: return lastControllerAxisState.LeftDown;
-    case SDL_AXIS_RIGHT_LEFT: return lastControllerAxisState.RightLeft;
-    case SDL_AXIS_RIGHT_RIGHT: return lastControllerAxisState.RightRight;
-    case SDL_AXIS_RIGHT_UP: return lastControllerAxisState.RightUp;
-    case SDL_AXIS_RIGHT_DOWN: return lastControllerAxisState.RightDown;
-    case SDL_AXIS_LTRIGGER_DOWN: return lastControllerAxisState.LTriggerDown;
-    case SDL_AXIS_RTRIGGER_DOWN: return lastControllerAxisState.RTriggerDown;
-    default: return false;
-    }
+ControllerAxisWasDown (const SDLAxis axis, const int slot) {
+    return AxisValue (lastControllerAxisState, axis, slot);
 }
 
 bool
-ControllerAxisWasUp (const SDLAxis axis) {
-    return !static_cast<bool> (ControllerAxisWasDown (axis));
+ControllerAxisWasUp (const SDLAxis axis, const int slot) {
+    return !static_cast<bool> (ControllerAxisWasDown (axis, slot));
 }
 
 bool
-ControllerAxisIsTapped (const SDLAxis axis) {
-    return static_cast<bool> (ControllerAxisIsDown (axis)) && ControllerAxisWasUp (axis);
+ControllerAxisIsTapped (const SDLAxis axis, const int slot) {
+    return static_cast<bool> (ControllerAxisIsDown (axis, slot)) && ControllerAxisWasUp (axis, slot);
 }
 
 bool
-ControllerAxisIsReleased (const SDLAxis axis) {
-    return ControllerAxisIsUp (axis) && static_cast<bool> (ControllerAxisWasDown (axis));
+ControllerAxisIsReleased (const SDLAxis axis, const int slot) {
+    return ControllerAxisIsUp (axis, slot) && static_cast<bool> (ControllerAxisWasDown (axis, slot));
 }
 
 bool
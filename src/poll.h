@@ -1,48 +1,26 @@
 #pragma once
 #include <SDL.h>
+#include <memory>
+#include "bindings.h"
 #include "helpers.h"
-
-enum SDLAxis {
-    SDL_AXIS_NULL,
-    SDL_AXIS_LEFT_LEFT,
-    SDL_AXIS_LEFT_RIGHT,
-    SDL_AXIS_LEFT_UP,
-    SDL_AXIS_LEFT_DOWN,
-    SDL_AXIS_RIGHT_LEFT,
-    SDL_AXIS_RIGHT_RIGHT,
-    SDL_AXIS_RIGHT_UP,
-    SDL_AXIS_RIGHT_DOWN,
-    SDL_AXIS_LTRIGGER_DOWN,
-    SDL_AXIS_RTRIGGER_DOWN,
-    SDL_AXIS_MAX
-};
-
-struct SDLAxisState {
-    float LeftLeft;
-    float LeftRight;
-    float LeftUp;
-    float LeftDown;
-    float RightLeft;
-    float RightRight;
-    float RightUp;
-    float RightDown;
-    float LTriggerDown;
-    float RTriggerDown;
-};
-
-enum Scroll { MOUSE_SCROLL_INVALID, MOUSE_SCROLL_UP, MOUSE_SCROLL_DOWN };
+#include "input.h"
+#include "replay.h"
 
 struct Keybindings {
     u8 keycodes[255];
     SDL_GameControllerButton buttons[255];
     SDLAxis axis[255];
     Scroll scroll[2];
+    u8 buttonSlots[255]; // 0 for any controller, otherwise the 1-based slot
+    u8 axisSlots[255];
+    CompiledBindings compiled;
 };
 
 enum EnumType { none, keycode, button, axis, scroll };
 
 struct ConfigValue {
     EnumType type;
+    u8 slot;
     union {
         u8 keycode;
         SDL_GameControllerButton button;
@@ -51,19 +29,25 @@ struct ConfigValue {
     };
 };
 
-struct InternalButtonState {
-    float Down;
-    bool Released;
-    bool Tapped;
-};
+// Receives every axis event of the controller in slot as the normalized value of each direction, timestamped in microseconds
+typedef void (*AxisMotionHandler) (int slot, SDLAxis axis, float value, u64 timestamp);
 
 bool InitializePoll (HWND windowHandle);
 void UpdatePoll (HWND windowHandle);
+void SetAxisMotionHandler (AxisMotionHandler handler);
+void SetInputBackend (std::unique_ptr<InputBackend> backend);
+void SetControllerSlots (const std::vector<std::string> &devices);
+void CaptureSnapshot (InputSnapshot &snapshot);
+void ApplySnapshot (const InputSnapshot &snapshot);
+void SetLogicalBindings (Keybindings *const *bindings, size_t count);
+LogicalInputFrame GetLogicalInput ();
 void DisposePoll ();
 void SetKeyboardButtons ();
 ConfigValue StringToConfigEnum (const char *value);
 void SetConfigValue (const toml_table_t *table, const char *key, Keybindings *key_bind);
+void CompileKeybindings (Keybindings *key_bind);
 InternalButtonState GetInternalButtonState (const Keybindings &bindings);
+bool SampleButtonDown (const Keybindings &bindings);
 void SetRumble (int left, int right, int length);
 
 bool KeyboardIsDown (u8 keycode);
@@ -84,18 +68,18 @@ bool GetWasMouseScrollDown ();
 bool GetMouseScrollIsReleased (Scroll scroll);
 bool GetMouseScrollIsDown (Scroll scroll);
 bool GetMouseScrollIsTapped (Scroll scroll);
-bool ControllerButtonIsDown (SDL_GameControllerButton button);
-bool ControllerButtonIsUp (SDL_GameControllerButton button);
-bool ControllerButtonWasDown (SDL_GameControllerButton button);
-bool ControllerButtonWasUp (SDL_GameControllerButton button);
-bool ControllerButtonIsTapped (SDL_GameControllerButton button);
-bool ControllerButtonIsReleased (SDL_GameControllerButton button);
-float ControllerAxisIsDown (SDLAxis axis);
-bool ControllerAxisIsUp (SDLAxis axis);
-float ControllerAxisWasDown (SDLAxis axis);
-bool ControllerAxisWasUp (SDLAxis axis);
-bool ControllerAxisIsTapped (SDLAxis axis);
-bool ControllerAxisIsReleased (SDLAxis axis);
+bool ControllerButtonIsDown (SDL_GameControllerButton button, int slot = AnySlot);
+bool ControllerButtonIsUp (SDL_GameControllerButton button, int slot = AnySlot);
+bool ControllerButtonWasDown (SDL_GameControllerButton button, int slot = AnySlot);
+bool ControllerButtonWasUp (SDL_GameControllerButton button, int slot = AnySlot);
+bool ControllerButtonIsTapped (SDL_GameControllerButton button, int slot = AnySlot);
+bool ControllerButtonIsReleased (SDL_GameControllerButton button, int slot = AnySlot);
+float ControllerAxisIsDown (SDLAxis axis, int slot = AnySlot);
+bool ControllerAxisIsUp (SDLAxis axis, int slot = AnySlot);
+float ControllerAxisWasDown (SDLAxis axis, int slot = AnySlot);
+bool ControllerAxisWasUp (SDLAxis axis, int slot = AnySlot);
+bool ControllerAxisIsTapped (SDLAxis axis, int slot = AnySlot);
+bool ControllerAxisIsReleased (SDLAxis axis, int slot = AnySlot);
 bool IsButtonTapped (const Keybindings &bindings);
 bool IsButtonReleased (const Keybindings &bindings);
 float IsButtonDown (const Keybindings &bindings);
@@ -0,0 +1,29 @@
+#include <fstream>
+#include "profiler.h"
+
+static std::atomic<ProfileSite *> sites{nullptr};
+
+ProfileSite::ProfileSite (std::string name) : name (std::move (name)) {
+    this->next = sites.load (std::memory_order_relaxed);
+    while (!sites.compare_exchange_weak (this->next, this, std::memory_order_release, std::memory_order_relaxed)) {}
+}
+
+ProfileSite *
+Profiler::Sites () {
+    return sites.load (std::memory_order_acquire);
+}
+
+bool
+Profiler::Dump (const std::string &path) {
+    std::ofstream csv (path, std::ios::trunc);
+    if (!csv.is_open ()) return false;
+
+    csv << "site,calls,total_ns,max_ns,p50_ns,p99_ns\n";
+    for (const ProfileSite *site = Sites (); site != nullptr; site = site->next) {
+        const uint64_t calls = site->calls.load (std::memory_order_relaxed);
+        if (calls == 0) continue;
+        csv << site->name << "," << calls << "," << site->total.load (std::memory_order_relaxed) << "," << site->durations.Max () << ","
+            << site->durations.Percentile (50) << "," << site->durations.Percentile (99) << "\n";
+    }
+    return true;
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include "histogram.h"
+
+/* *
+ * Call count and duration of one hook, plugin event or subsystem, in nanoseconds.
+ *
+ * Sites link themselves into a global list when constructed and live for the whole process,
+ * so they can be static objects next to the code they measure.
+ */
+struct ProfileSite {
+    explicit ProfileSite (std::string name);
+    ProfileSite (const ProfileSite &) = delete;
+
+    std::string name;
+    std::atomic<uint64_t> calls{0};
+    std::atomic<uint64_t> total{0};
+    Histogram durations;
+    ProfileSite *next = nullptr;
+};
+
+namespace Profiler {
+inline std::atomic<bool> enabled{false};
+
+inline uint64_t
+Now () {
+    return std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now ().time_since_epoch ()).count ();
+}
+
+ProfileSite *Sites ();
+bool Dump (const std::string &path);
+} // namespace Profiler
+
+/* Times the enclosing scope into a site while profiling is enabled, otherwise it costs one relaxed load. */
+class ProfileScope {
+public:
+    explicit ProfileScope (ProfileSite &site) : site (site), active (Profiler::enabled.load (std::memory_order_relaxed)) {
+        if (this->active) this->start = Profiler::Now ();
+    }
+
+    ~ProfileScope () {
+        if (!this->active) return;
+        const uint64_t duration = Profiler::Now () - this->start;
+        this->site.calls.fetch_add (1, std::memory_order_relaxed);
+        this->site.total.fetch_add (duration, std::memory_order_relaxed);
+        this->site.durations.Record (duration);
+    }
+
+private:
+    ProfileSite &site;
+    bool active;
+    uint64_t start = 0;
+};
+
+#ifdef PROFILING
+#define PROFILE_SCOPE(site) ProfileScope profileScope (site)
+#else
+#define PROFILE_SCOPE(site)
+#endif
+
+// Wraps a hook implementation in a ProfileScope, so the installed detour has the same signature as the hook
+template <auto Impl, ProfileSite *Site>
+struct ProfiledHook;
+
+template <typename R, typename... Args, R (*Impl) (Args...), ProfileSite *Site>
+struct ProfiledHook<Impl, Site> {
+    static R
+    Call (Args... args) {
+        ProfileScope scope (*Site);
+        return Impl (args...);
+    }
+};
@@ -0,0 +1,142 @@
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include "replay.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+struct RecordingHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t snapshotSize;
+    uint32_t reserved;
+};
+
+static constexpr RecordingHeader currentHeader = {{'T', 'P', 'I', 'R'}, 2, sizeof (InputSnapshot), 0};
+
+bool
+InputRecorder::Open (const char *path) {
+    this->Close ();
+    this->lastTimestamp = 0;
+    this->shift         = 0;
+    this->started       = false;
+
+    // Only a recording in the current format is continued, anything else is moved aside
+    std::error_code error;
+    if (uintmax_t size = std::filesystem::file_size (path, error); !error && size > 0) {
+        std::ifstream existing (path, std::ios::binary);
+        RecordingHeader header{};
+        bool valid = existing.read (reinterpret_cast<char *> (&header), sizeof (header)) && memcmp (&header, &currentHeader, sizeof (header)) == 0;
+
+        // A crash can leave a partly written snapshot at the end
+        const uintmax_t snapshots = valid ? (size - sizeof (header)) / sizeof (InputSnapshot) : 0;
+        if (snapshots > 0) {
+            InputSnapshot last{};
+            existing.seekg (static_cast<std::streamoff> (sizeof (header) + (snapshots - 1) * sizeof (InputSnapshot)));
+            valid               = static_cast<bool> (existing.read (reinterpret_cast<char *> (&last), sizeof (last)));
+            this->lastTimestamp = last.timestamp;
+        }
+        existing.close ();
+
+        // Recordings of an older snapshot layout are kept as path.v<version> for the build that can replay them
+        const bool otherVersion = memcmp (header.magic, currentHeader.magic, sizeof (header.magic)) == 0 && header.version != currentHeader.version;
+        if (valid) std::filesystem::resize_file (path, sizeof (header) + snapshots * sizeof (InputSnapshot), error);
+        else std::filesystem::rename (path, std::string (path) + (otherVersion ? ".v" + std::to_string (header.version) : ".1"), error);
+    }
+
+    this->file = std::fopen (path, "ab");
+    if (this->file == nullptr) return false;
+
+    std::setvbuf (this->file, nullptr, _IOFBF, 64 * 1024);
+    std::fseek (this->file, 0, SEEK_END);
+    if (std::ftell (this->file) == 0) std::fwrite (&currentHeader, sizeof (currentHeader), 1, this->file);
+    return true;
+}
+
+void
+InputRecorder::Write (const InputSnapshot &snapshot) {
+    if (this->file == nullptr) return;
+    // Replay expects time to only go forward, a session appended after a restart continues where the last one ended
+    if (!this->started) {
+        this->started = true;
+        if (snapshot.timestamp <= this->lastTimestamp) this->shift = this->lastTimestamp + 1 - snapshot.timestamp;
+    }
+    InputSnapshot shifted = snapshot;
+    shifted.timestamp += this->shift;
+    std::fwrite (&shifted, sizeof (shifted), 1, this->file);
+}
+
+void
+InputRecorder::Close () {
+    if (this->file == nullptr) return;
+    std::fclose (this->file);
+    this->file = nullptr;
+}
+
+bool
+InputReplay::Open (const char *path) {
+    this->Close ();
+#ifdef _WIN32
+    this->file = CreateFileA (path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (this->file == INVALID_HANDLE_VALUE) {
+        this->file = nullptr;
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx (this->file, &fileSize) || fileSize.QuadPart < (LONGLONG)sizeof (RecordingHeader)) {
+        this->Close ();
+        return false;
+    }
+    this->size    = static_cast<size_t> (fileSize.QuadPart);
+    this->mapping = CreateFileMappingA (this->file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (this->mapping != nullptr) this->view = MapViewOfFile (this->mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+    const int fd = open (path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info {};
+    if (fstat (fd, &info) == 0 && info.st_size >= (off_t)sizeof (RecordingHeader)) {
+        this->size = static_cast<size_t> (info.st_size);
+        if (void *view = mmap (nullptr, this->size, PROT_READ, MAP_PRIVATE, fd, 0); view != MAP_FAILED) this->view = view;
+    }
+    close (fd);
+#endif
+    if (this->view == nullptr || memcmp (this->view, &currentHeader, sizeof (RecordingHeader)) != 0) {
+        this->Close ();
+        return false;
+    }
+
+    this->data  = reinterpret_cast<const InputSnapshot *> (static_cast<const char *> (this->view) + sizeof (RecordingHeader));
+    this->count = (this->size - sizeof (RecordingHeader)) / sizeof (InputSnapshot);
+    return true;
+}
+
+const InputSnapshot *
+InputReplay::Next () {
+    if (this->position >= this->count) return nullptr;
+    return &this->data[this->position++];
+}
+
+void
+InputReplay::Close () {
+#ifdef _WIN32
+    if (this->view != nullptr) UnmapViewOfFile (this->view);
+    if (this->mapping != nullptr) CloseHandle (this->mapping);
+    if (this->file != nullptr) CloseHandle (this->file);
+    this->mapping = nullptr;
+    this->file    = nullptr;
+#else
+    if (this->view != nullptr) munmap (const_cast<void *> (this->view), this->size);
+#endif
+    this->view     = nullptr;
+    this->size     = 0;
+    this->data     = nullptr;
+    this->count    = 0;
+    this->position = 0;
+}
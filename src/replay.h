@@ -0,0 +1,66 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+/* Everything UpdatePoll produces in one frame, the unit of input recordings. */
+struct InputSnapshot {
+    static constexpr size_t Controllers = 4;
+
+    uint64_t timestamp;
+    uint64_t keyboard[4];
+    uint64_t buttons[Controllers];
+    uint64_t scroll;
+    float axis[Controllers][10];
+};
+static_assert (sizeof (InputSnapshot) == 240);
+
+/* *
+ * Appends snapshots to a recording.
+ *
+ * A recording is a small header followed by fixed size snapshots, so appending
+ * to an existing file continues it and a crash loses at most the buffered tail.
+ * Timestamps of an appended session are shifted to follow the recorded ones, a file
+ * that is not a recording of the current format is moved aside instead, to path.v1 for
+ * a version 1 recording and to path.1 for anything else.
+ */
+class InputRecorder {
+public:
+    ~InputRecorder () { this->Close (); }
+
+    bool Open (const char *path);
+    void Write (const InputSnapshot &snapshot);
+    void Close ();
+    bool IsOpen () const { return this->file != nullptr; }
+
+private:
+    std::FILE *file        = nullptr;
+    uint64_t lastTimestamp = 0;
+    uint64_t shift         = 0;
+    bool started           = false;
+};
+
+/* Plays a recording back from a read-only memory mapping, snapshots are handed out without copying. */
+class InputReplay {
+public:
+    ~InputReplay () { this->Close (); }
+
+    bool Open (const char *path);
+    const InputSnapshot *Next ();
+    void Close ();
+    bool IsOpen () const { return this->view != nullptr; }
+
+    size_t Position () const { return this->position; }
+    size_t Count () const { return this->count; }
+
+private:
+    const void *view          = nullptr;
+    size_t size               = 0;
+    const InputSnapshot *data = nullptr;
+    size_t count              = 0;
+    size_t position           = 0;
+#ifdef _WIN32
+    void *file    = nullptr;
+    void *mapping = nullptr;
+#endif
+};
@@ -0,0 +1,208 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+constexpr size_t CacheLineSize = 64;
+
+/* *
+ * Lock-free single-producer/single-consumer ring.
+ *
+ * Push must only be called from one thread and Pop from one other thread.
+ * Each side caches the opposite index so the shared cache line is only read when the ring looks full or empty.
+ */
+template <typename T, size_t Capacity>
+class SpscRing {
+    static_assert (Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    bool
+    Push (const T &value) {
+        const size_t head = this->head.load (std::memory_order_relaxed);
+        if (head - this->cachedTail == Capacity) {
+            this->cachedTail = this->tail.load (std::memory_order_acquire);
+            if (head - this->cachedTail == Capacity) return false;
+        }
+        this->items[head & (Capacity - 1)] = value;
+        this->head.store (head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool
+    Pop (T &value) {
+        const size_t tail = this->tail.load (std::memory_order_relaxed);
+        if (tail == this->cachedHead) {
+            this->cachedHead = this->head.load (std::memory_order_acquire);
+            if (tail == this->cachedHead) return false;
+        }
+        value = this->items[tail & (Capacity - 1)];
+        this->tail.store (tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool
+    Empty () const {
+        return this->head.load (std::memory_order_acquire) == this->tail.load (std::memory_order_acquire);
+    }
+
+    size_t
+    Size () const {
+        return this->head.load (std::memory_order_acquire) - this->tail.load (std::memory_order_acquire);
+    }
+
+private:
+    alignas (CacheLineSize) std::atomic<size_t> head{0};
+    size_t cachedTail = 0;
+    alignas (CacheLineSize) std::atomic<size_t> tail{0};
+    size_t cachedHead = 0;
+    alignas (CacheLineSize) std::array<T, Capacity> items{};
+};
+
+/* *
+ * Bounded lock-free multi-producer/single-consumer ring.
+ *
+ * Every cell carries a sequence number telling producers whether it is free and the consumer whether it is filled,
+ * so producers only contend on claiming the head index and never wait for each other to finish writing.
+ */
+template <typename T, size_t Capacity>
+class MpscRing {
+    static_assert (Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    MpscRing () {
+        for (size_t i = 0; i < Capacity; i++)
+            this->cells[i].sequence.store (i, std::memory_order_relaxed);
+    }
+
+    bool
+    Push (const T &value) {
+        size_t position;
+        T *slot = this->Claim (position);
+        if (slot == nullptr) return false;
+        *slot = value;
+        this->Commit (position);
+        return true;
+    }
+
+    // Claims a slot to fill in place, the consumer only sees it once the position is committed
+    T *
+    Claim (size_t &position) {
+        size_t head = this->head.load (std::memory_order_relaxed);
+        for (;;) {
+            Cell &cell            = this->cells[head & (Capacity - 1)];
+            const size_t sequence = cell.sequence.load (std::memory_order_acquire);
+            if (sequence == head) {
+                if (this->head.compare_exchange_weak (head, head + 1, std::memory_order_relaxed)) {
+                    position = head;
+                    return &cell.value;
+                }
+            } else if (static_cast<ptrdiff_t> (sequence - head) < 0) return nullptr;
+            else head = this->head.load (std::memory_order_relaxed);
+        }
+    }
+
+    void Commit (const size_t position) { this->cells[position & (Capacity - 1)].sequence.store (position + 1, std::memory_order_release); }
+
+    bool
+    Pop (T &value) {
+        return this->Consume ([&] (const T &item) { value = item; });
+    }
+
+    // Hands the oldest committed item to consume without copying it out of the ring
+    template <typename Function>
+    bool
+    Consume (Function &&consume) {
+        Cell &cell = this->cells[this->tail & (Capacity - 1)];
+        if (cell.sequence.load (std::memory_order_acquire) != this->tail + 1) return false;
+        consume (static_cast<const T &> (cell.value));
+        cell.sequence.store (this->tail + Capacity, std::memory_order_release);
+        this->tail++;
+        return true;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    alignas (CacheLineSize) std::atomic<size_t> head{0};
+    alignas (CacheLineSize) size_t tail = 0;
+    alignas (CacheLineSize) std::array<Cell, Capacity> cells;
+};
+
+/* *
+ * Single threaded ring with fixed storage, it never allocates.
+ *
+ * The usable capacity can be lowered at runtime up to MaxCapacity.
+ * Pushes that do not fit are counted as overflows, either rejecting the new item or evicting the oldest one.
+ */
+template <typename T, size_t MaxCapacity>
+class FixedRing {
+    static_assert (MaxCapacity >= 1, "MaxCapacity must be at least 1");
+
+public:
+    void
+    SetCapacity (const size_t capacity) {
+        this->capacity = capacity < 1 ? 1 : capacity > MaxCapacity ? MaxCapacity : capacity;
+        this->Clear ();
+    }
+
+    bool
+    Push (const T &value) {
+        if (this->Full ()) {
+            this->overflows++;
+            return false;
+        }
+        this->items[(this->head + this->count) % MaxCapacity] = value;
+        this->count++;
+        return true;
+    }
+
+    void
+    PushOverwrite (const T &value) {
+        if (this->Full ()) {
+            this->overflows++;
+            this->Pop ();
+        }
+        this->Push (value);
+    }
+
+    bool
+    Pop () {
+        if (this->Empty ()) return false;
+        this->head = (this->head + 1) % MaxCapacity;
+        this->count--;
+        return true;
+    }
+
+    bool
+    Pop (T &value) {
+        if (this->Empty ()) return false;
+        value = this->items[this->head];
+        return this->Pop ();
+    }
+
+    T &Front () { return this->items[this->head]; }
+    T &Back () { return this->items[(this->head + this->count - 1) % MaxCapacity]; }
+
+    void
+    Clear () {
+        this->head  = 0;
+        this->count = 0;
+    }
+
+    bool Empty () const { return this->count == 0; }
+    bool Full () const { return this->count >= this->capacity; }
+    size_t Size () const { return this->count; }
+    size_t Capacity () const { return this->capacity; }
+    uint64_t Overflows () const { return this->overflows; }
+
+private:
+    alignas (CacheLineSize) std::array<T, MaxCapacity> items{};
+    size_t head        = 0;
+    size_t count       = 0;
+    size_t capacity    = MaxCapacity;
+    uint64_t overflows = 0;
+};
@@ -0,0 +1,47 @@
+#include <chrono>
+#include "sampler.h"
+
+uint64_t
+InputSampler::Now () {
+    return std::chrono::duration_cast<std::chrono::microseconds> (std::chrono::steady_clock::now ().time_since_epoch ()).count ();
+}
+
+void
+InputSampler::Start (const uint32_t rate) {
+    if (this->running.exchange (true) || rate == 0) return;
+    this->thread = std::thread (&InputSampler::Run, this, rate);
+}
+
+void
+InputSampler::Stop () {
+    this->running.store (false, std::memory_order_relaxed);
+    if (this->thread.joinable ()) this->thread.join ();
+}
+
+void
+InputSampler::SampleOnce (const uint64_t timestamp) {
+    const uint8_t state   = this->source ();
+    const uint8_t changed = state ^ this->lastState;
+    this->lastState       = state;
+
+    for (uint8_t pad = 0; pad < 8; pad++) {
+        if (!(changed & (1 << pad))) continue;
+        if (!this->events.Push ({timestamp, pad, static_cast<bool> (state & (1 << pad))}))
+            this->dropped.fetch_add (1, std::memory_order_relaxed);
+    }
+}
+
+void
+InputSampler::Run (const uint32_t rate) {
+    const auto period = std::chrono::nanoseconds (1000000000 / rate);
+    auto next         = std::chrono::steady_clock::now ();
+
+    while (this->running.load (std::memory_order_relaxed)) {
+        this->SampleOnce (Now ());
+
+        // Skip missed ticks instead of sampling in a burst to catch up
+        next += period;
+        if (const auto now = std::chrono::steady_clock::now (); next < now) next = now;
+        std::this_thread::sleep_until (next);
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include "ring.h"
+
+/* A drum pad changing state, timestamped in microseconds of the steady clock. */
+struct DrumEvent {
+    uint64_t timestamp;
+    uint8_t pad;
+    bool pressed;
+};
+
+/* *
+ * Samples up to 8 pads at a fixed rate on its own thread and turns state changes into DrumEvents.
+ *
+ * The source returns one bit per pad and is the only platform specific part,
+ * SampleOnce can be driven directly to step the sampler without a thread.
+ */
+class InputSampler {
+public:
+    typedef std::function<uint8_t ()> Source;
+
+    explicit InputSampler (Source source) : source (std::move (source)) {}
+    ~InputSampler () { this->Stop (); }
+
+    void Start (uint32_t rate);
+    void Stop ();
+    bool Running () const { return this->running.load (std::memory_order_relaxed); }
+
+    void SampleOnce (uint64_t timestamp);
+    bool Pop (DrumEvent &event) { return this->events.Pop (event); }
+    uint64_t Dropped () const { return this->dropped.load (std::memory_order_relaxed); }
+
+    static uint64_t Now ();
+
+private:
+    void Run (uint32_t rate);
+
+    Source source;
+    uint8_t lastState = 0;
+    std::thread thread;
+    std::atomic<bool> running{false};
+    std::atomic<uint64_t> dropped{0};
+    SpscRing<DrumEvent, 1024> events;
+};
@@ -0,0 +1,129 @@
+#include <chrono>
+#include "scheduler.h"
+
+FrameScheduler::Task &
+FrameScheduler::Add (const char *name, const TaskPhase phase, const uint64_t budget, Work work, const uint64_t period, const bool worker) {
+    auto task    = std::make_unique<Task> ();
+    task->name   = name;
+    task->phase  = phase;
+    task->budget = budget;
+    task->period = period;
+    task->worker = worker;
+    task->work   = std::move (work);
+    if (phase == TaskPhase::Periodic) task->nextRun = this->clock () + period;
+    this->tasks.push_back (std::move (task));
+    return *this->tasks.back ();
+}
+
+bool
+FrameScheduler::BeginFrame () {
+    const uint64_t now = this->clock ();
+    if (this->frame > 0 && now - this->frameStart < this->frameInterval) return false;
+    this->frame++;
+    this->frameStart = now;
+    return true;
+}
+
+void
+FrameScheduler::Run (const TaskPhase phase) {
+    const uint64_t now = this->clock ();
+    for (const auto &task : this->tasks) {
+        // Periodic tasks are checked with the post-present pass so they never delay a frame
+        if (task->phase == TaskPhase::Periodic ? phase != TaskPhase::PostPresent : task->phase != phase) continue;
+        if (task->frame == this->frame) continue;
+        if (task->worker && task->busy.load (std::memory_order_acquire)) {
+            task->skipped.fetch_add (1, std::memory_order_relaxed);
+            if (!task->stalled && task->budget > 0 && now - task->posted > task->budget) {
+                task->stalled = true;
+                task->stalls.fetch_add (1, std::memory_order_relaxed);
+                if (this->stallHandler) this->stallHandler (*task);
+            }
+            continue;
+        }
+        if (task->phase == TaskPhase::Periodic) {
+            if (now < task->nextRun) continue;
+            task->nextRun = now + task->period;
+        }
+        task->frame = this->frame;
+
+        if (task->worker) this->Post (*task, now);
+        else this->Execute (*task);
+    }
+}
+
+void
+FrameScheduler::Execute (Task &task) {
+    const uint64_t start = this->clock ();
+    task.work ();
+    const uint64_t duration = this->clock () - start;
+
+    task.durations.Record (duration);
+    task.lastDuration.store (duration, std::memory_order_relaxed);
+    task.runs.fetch_add (1, std::memory_order_relaxed);
+    if (task.budget > 0 && duration > task.budget) task.overruns.fetch_add (1, std::memory_order_relaxed);
+}
+
+void
+FrameScheduler::Post (Task &task, const uint64_t now) {
+    task.busy.store (true, std::memory_order_relaxed);
+    task.posted  = now;
+    task.stalled = false;
+    {
+        std::lock_guard lock (this->mutex);
+        if (this->workers.empty () && !this->stopping) {
+            for (size_t i = 0; i < this->workerCount; i++)
+                this->workers.emplace_back (&FrameScheduler::Worker, this);
+            this->running = this->workerCount;
+        }
+        this->queue.push_back (&task);
+    }
+    this->wake.notify_one ();
+}
+
+void
+FrameScheduler::Worker () {
+    std::unique_lock lock (this->mutex);
+    for (;;) {
+        this->wake.wait (lock, [this] { return this->stopping || !this->queue.empty (); });
+        if (this->stopping) {
+            this->running--;
+            this->finished.notify_all ();
+            return;
+        }
+
+        Task *task = this->queue.front ();
+        this->queue.pop_front ();
+        lock.unlock ();
+        this->Execute (*task);
+        task->busy.store (false, std::memory_order_release);
+        lock.lock ();
+    }
+}
+
+std::vector<const FrameScheduler::Task *>
+FrameScheduler::Stop (const uint64_t timeout) {
+    std::unique_lock lock (this->mutex);
+    if (this->stopping) return {};
+    this->stopping = true;
+    for (Task *task : this->queue)
+        task->busy.store (false, std::memory_order_release);
+    this->queue.clear ();
+    this->wake.notify_all ();
+
+    // A task that never returns would otherwise hang the exit of the game
+    const auto done = [this] { return this->running == 0; };
+    if (timeout == UINT64_MAX) this->finished.wait (lock, done);
+    else this->finished.wait_for (lock, std::chrono::microseconds (timeout), done);
+
+    std::vector<const Task *> abandoned;
+    if (this->running > 0)
+        for (const auto &task : this->tasks)
+            if (task->worker && task->busy.load (std::memory_order_acquire)) abandoned.push_back (task.get ());
+    lock.unlock ();
+
+    for (auto &worker : this->workers)
+        if (abandoned.empty ()) worker.join ();
+        else worker.detach ();
+    this->workers.clear ();
+    return abandoned;
+}
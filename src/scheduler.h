@@ -0,0 +1,91 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "histogram.h"
+
+/* When a task runs: before or after the game presents a frame, or every period microseconds after present. */
+enum class TaskPhase { PrePresent, PostPresent, Periodic };
+
+/* *
+ * Runs the per-frame work of registered tasks, each at most once per frame.
+ *
+ * BeginFrame starts a new frame, unless the frame interval has not elapsed yet, so call sites that
+ * fire several times per frame do not run tasks again. Every run is timed with the clock,
+ * runs longer than the task budget count as overruns. Tasks marked as worker tasks are handed
+ * to a pool of background threads instead and are skipped while their previous run is still going,
+ * a worker task still running past its budget is reported once to the stall handler. Stop waits
+ * a bounded time for the workers and leaves the ones stuck in a task behind.
+ * Times are in microseconds, the clock can be replaced to drive the scheduler without real time.
+ */
+class FrameScheduler {
+public:
+    typedef std::function<uint64_t ()> Clock;
+    typedef std::function<void ()> Work;
+    struct Task;
+    typedef std::function<void (const Task &task)> StallHandler;
+
+    struct Task {
+        const char *name;
+        TaskPhase phase;
+        uint64_t budget;
+        uint64_t period;
+        bool worker;
+        Work work;
+
+        uint64_t frame   = 0;
+        uint64_t nextRun = 0;
+        uint64_t posted  = 0;
+        bool stalled     = false;
+        std::atomic<bool> busy{false};
+        std::atomic<uint64_t> stalls{0};
+        std::atomic<uint64_t> runs{0};
+        std::atomic<uint64_t> overruns{0};
+        std::atomic<uint64_t> skipped{0};
+        std::atomic<uint64_t> lastDuration{0};
+        Histogram durations;
+    };
+
+    explicit FrameScheduler (Clock clock) : clock (std::move (clock)) {}
+    ~FrameScheduler () { this->Stop (UINT64_MAX); }
+
+    Task &Add (const char *name, TaskPhase phase, uint64_t budget, Work work, uint64_t period = 0, bool worker = false);
+    void SetFrameInterval (const uint64_t interval) { this->frameInterval = interval; }
+    void SetWorkers (const size_t count) { this->workerCount = count < 1 ? 1 : count; }
+    void SetStallHandler (StallHandler handler) { this->stallHandler = std::move (handler); }
+
+    bool BeginFrame ();
+    void Run (TaskPhase phase);
+    // Drops queued worker runs and waits up to timeout microseconds of real time, returns the tasks whose workers were abandoned
+    std::vector<const Task *> Stop (uint64_t timeout);
+
+    uint64_t Frame () const { return this->frame; }
+    const std::vector<std::unique_ptr<Task>> &Tasks () const { return this->tasks; }
+
+private:
+    void Execute (Task &task);
+    void Post (Task &task, uint64_t now);
+    void Worker ();
+
+    Clock clock;
+    std::vector<std::unique_ptr<Task>> tasks;
+    uint64_t frameInterval = 0;
+    uint64_t frame         = 0;
+    uint64_t frameStart    = 0;
+
+    StallHandler stallHandler;
+    size_t workerCount = 1;
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    std::deque<Task *> queue;
+    size_t running = 0;
+    bool stopping  = false;
+};
@@ -0,0 +1,152 @@
+#include <chrono>
+#include <mutex>
+#include "trace.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define TRACE_STRING(x)  #x
+#define TRACE_XSTRING(x) TRACE_STRING (x)
+
+static std::atomic<TraceHeader *> mapped{nullptr};
+static TraceRecord *records = nullptr;
+static uint64_t recordCount = 0;
+static uint64_t startTicks  = 0;
+static std::mutex registerMutex;
+
+// Raw performance counter on Windows, steady_clock would also convert every reading to nanoseconds
+static uint64_t
+Ticks () {
+#ifdef _WIN32
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter (&counter);
+    return static_cast<uint64_t> (counter.QuadPart);
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now ().time_since_epoch ()).count ();
+#endif
+}
+
+static uint64_t
+TickFrequency () {
+#ifdef _WIN32
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency (&frequency);
+    return static_cast<uint64_t> (frequency.QuadPart);
+#else
+    return 1000000000;
+#endif
+}
+
+static uint32_t
+ThreadId () {
+    thread_local const uint32_t id =
+#ifdef _WIN32
+        static_cast<uint32_t> (GetCurrentThreadId ());
+#else
+        static_cast<uint32_t> (syscall (SYS_gettid));
+#endif
+    return id;
+}
+
+bool
+Trace::Open (const std::string &path, const uint64_t count) {
+    std::lock_guard lock (registerMutex);
+    if (mapped.load (std::memory_order_relaxed) != nullptr || count == 0) return false;
+    const uint32_t offset = (sizeof (TraceHeader) + 4095) & ~4095u;
+    const uint64_t size   = offset + count * sizeof (TraceRecord);
+
+    void *view = nullptr;
+#ifdef _WIN32
+    const HANDLE file = CreateFileA (path.c_str (), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    // The view keeps the mapping and the file alive once both handles are closed
+    if (const HANDLE mapping = CreateFileMappingA (file, nullptr, PAGE_READWRITE, static_cast<DWORD> (size >> 32), static_cast<DWORD> (size), nullptr)) {
+        view = MapViewOfFile (mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+        CloseHandle (mapping);
+    }
+    CloseHandle (file);
+#else
+    const int fd = open (path.c_str (), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    if (ftruncate (fd, static_cast<off_t> (size)) == 0)
+        if (void *map = mmap (nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0); map != MAP_FAILED) view = map;
+    close (fd);
+#endif
+    if (view == nullptr) return false;
+
+    // A new file is zero filled, so every record starts out incomplete
+    auto *header = static_cast<TraceHeader *> (view);
+    memcpy (header->magic, TraceMagic, sizeof (TraceMagic));
+    header->version      = TraceVersion;
+    header->recordSize   = sizeof (TraceRecord);
+    header->recordOffset = offset;
+    header->recordCount  = count;
+    header->startTime    = std::chrono::duration_cast<std::chrono::microseconds> (std::chrono::system_clock::now ().time_since_epoch ()).count ();
+    header->frequency    = TickFrequency ();
+    startTicks           = Ticks ();
+    records              = reinterpret_cast<TraceRecord *> (static_cast<uint8_t *> (view) + offset);
+    recordCount          = count;
+    mapped.store (header, std::memory_order_release);
+    enabled.store (true, std::memory_order_relaxed);
+    return true;
+}
+
+// The mapping stays until the process exits, hooks on other threads may still be writing
+void
+Trace::Close () {
+    enabled.store (false, std::memory_order_relaxed);
+    TraceHeader *header = mapped.load (std::memory_order_acquire);
+    if (header == nullptr) return;
+#ifdef _WIN32
+    FlushViewOfFile (header, 0);
+#else
+    msync (header, header->recordOffset + recordCount * sizeof (TraceRecord), MS_ASYNC);
+#endif
+}
+
+uint16_t
+Trace::Register (TraceSite &site, const char *file, const int line, const std::string_view format) {
+    std::lock_guard lock (registerMutex);
+    if (const uint16_t id = site.id.load (std::memory_order_relaxed)) return id;
+    TraceHeader *header = mapped.load (std::memory_order_relaxed);
+    if (header == nullptr || header->siteCount == TraceMaxSites) return 0;
+
+    // Keep the path relative to the sources like the text log does
+    std::string_view filename = file;
+#ifdef SOURCE_ROOT
+    constexpr std::string_view root = TRACE_XSTRING (SOURCE_ROOT);
+    if (filename.starts_with (root.substr (0, root.size () - 1))) filename.remove_prefix (root.size ());
+#endif
+    if (filename.size () >= TraceSiteFileSize) filename.remove_prefix (filename.size () - TraceSiteFileSize + 1);
+
+    TraceSiteEntry &entry = header->sites[header->siteCount];
+    entry.line            = static_cast<uint32_t> (line);
+    memcpy (entry.file, filename.data (), filename.size ());
+    memcpy (entry.format, format.data (), std::min (format.size (), TraceSiteFormatSize - 1));
+    const auto id = static_cast<uint16_t> (++header->siteCount);
+    site.id.store (id, std::memory_order_release);
+    return id;
+}
+
+void
+Trace::Write (const uint16_t site, const uint8_t *arguments, const size_t size) {
+    TraceHeader *header = mapped.load (std::memory_order_acquire);
+    if (header == nullptr) return;
+    const uint64_t position = std::atomic_ref (header->head).fetch_add (1, std::memory_order_relaxed);
+    TraceRecord &record     = records[position % recordCount];
+
+    // tracedump only keeps records whose sequence matches their slot, a torn or overwritten one is skipped
+    std::atomic_ref sequence (record.sequence);
+    sequence.store (0, std::memory_order_relaxed);
+    record.time   = Ticks () - startTicks;
+    record.site   = site;
+    record.size   = static_cast<uint8_t> (size);
+    record.thread = ThreadId ();
+    memcpy (record.arguments, arguments, size);
+    sequence.store (position + 1, std::memory_order_release);
+}
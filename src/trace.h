@@ -0,0 +1,119 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+/* *
+ * Binary trace of hot hooks, for HOOKS level debugging without formatting text on the game thread.
+ *
+ * A call site registers its format string once, every record then only holds the site id, a timestamp, the thread
+ * and the raw argument bytes. Records go into a ring in a memory-mapped file, so the last ones survive a crash.
+ * The layout below is shared with tracedump, which turns the file back into text offline.
+ */
+constexpr char TraceMagic[4]         = {'T', 'A', 'L', 'T'};
+constexpr uint32_t TraceVersion      = 1;
+constexpr size_t TraceMaxSites       = 255;
+constexpr size_t TraceArgumentBytes  = 40;
+constexpr size_t TraceSiteFileSize   = 56;
+constexpr size_t TraceSiteFormatSize = 192;
+
+// High nibble of the tag in front of every argument, the low nibble is its size in bytes
+enum class TraceArgument : uint8_t { Signed = 1, Unsigned, Float, Bool, Pointer, String };
+
+struct TraceSiteEntry {
+    uint32_t line;
+    uint32_t reserved;
+    char file[TraceSiteFileSize];
+    char format[TraceSiteFormatSize];
+};
+
+struct TraceHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t recordOffset;
+    uint64_t recordCount;
+    uint64_t head;      // Next ring position, records are at position % recordCount
+    uint64_t startTime; // Unix time when the trace was opened in microseconds, record times are relative to it
+    uint64_t frequency; // Record time ticks per second
+    uint32_t siteCount;
+    uint32_t reserved;
+    TraceSiteEntry sites[TraceMaxSites]; // Indexed by site id - 1
+};
+
+struct TraceRecord {
+    uint64_t sequence; // Ring position + 1 once the record is complete, 0 while it is written
+    uint64_t time;     // Ticks since startTime
+    uint16_t site;
+    uint8_t size;
+    uint8_t reserved;
+    uint32_t thread;
+    uint8_t arguments[TraceArgumentBytes];
+};
+static_assert (sizeof (TraceRecord) == 64);
+
+/* One TRACE call site, its id is assigned when it is first recorded. */
+struct TraceSite {
+    std::atomic<uint16_t> id{0};
+};
+
+namespace Trace {
+inline std::atomic<bool> enabled{false};
+
+bool Open (const std::string &path, uint64_t recordCount);
+void Close ();
+uint16_t Register (TraceSite &site, const char *file, int line, std::string_view format);
+void Write (uint16_t site, const uint8_t *arguments, size_t size);
+
+// Appends one argument, arguments that no longer fit are left out and strings are cut
+template <typename T>
+void
+Encode (uint8_t *buffer, size_t &size, const T &value) {
+    using Value = std::decay_t<T>;
+    const auto put = [&] (const TraceArgument kind, const void *data, const size_t length) {
+        if (size + 1 + length > TraceArgumentBytes) return;
+        buffer[size++] = static_cast<uint8_t> (static_cast<uint8_t> (kind) << 4 | length);
+        memcpy (buffer + size, data, length);
+        size += length;
+    };
+
+    if constexpr (std::is_same_v<Value, bool>) {
+        put (TraceArgument::Bool, &value, 1);
+    } else if constexpr (std::is_integral_v<Value> || std::is_enum_v<Value>) {
+        put (std::is_signed_v<Value> ? TraceArgument::Signed : TraceArgument::Unsigned, &value, sizeof (Value));
+    } else if constexpr (std::is_floating_point_v<Value>) {
+        put (TraceArgument::Float, &value, sizeof (Value));
+    } else if constexpr (std::is_convertible_v<const Value &, std::string_view>) {
+        std::string_view text;
+        if constexpr (std::is_pointer_v<T>) text = value != nullptr ? std::string_view (value) : std::string_view ("(null)");
+        else text = value;
+        if (size + 2 > TraceArgumentBytes) return;
+        const size_t length = std::min (text.size (), TraceArgumentBytes - size - 2);
+        buffer[size++]      = static_cast<uint8_t> (static_cast<uint8_t> (TraceArgument::String) << 4);
+        buffer[size++]      = static_cast<uint8_t> (length);
+        memcpy (buffer + size, text.data (), length);
+        size += length;
+    } else if constexpr (std::is_pointer_v<Value>) {
+        const uint64_t address = reinterpret_cast<uintptr_t> (value);
+        put (TraceArgument::Pointer, &address, sizeof (address));
+    } else {
+        static_assert (!sizeof (Value), "Only numbers, pointers and strings can be traced");
+    }
+}
+
+template <typename... Args>
+void
+Record (TraceSite &site, const char *file, const int line, const std::string_view format, const Args &...args) {
+    uint16_t id = site.id.load (std::memory_order_acquire);
+    if (id == 0 && (id = Register (site, file, line, format)) == 0) return;
+    uint8_t buffer[TraceArgumentBytes];
+    size_t size = 0;
+    (Encode (buffer, size, args), ...);
+    Write (id, buffer, size);
+}
+} // namespace Trace
@@ -0,0 +1,128 @@
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "trace.h"
+
+/* *
+ * tracedump: turns a trace written with trace = true back into text.
+ *
+ * Only needs trace.h, so it also builds outside of the loader, e.g. on Linux:
+ *     c++ -std=c++20 -O2 -Isrc src/tracedump/main.cpp -o tracedump
+ * Records are printed oldest first, the ones overwritten by the ring or torn by a crash are skipped.
+ */
+
+// Formats the next argument, the only format spec looked at is a trailing x for hexadecimal
+static bool
+AppendArgument (std::string &out, const uint8_t *&argument, const uint8_t *end, const bool hex) {
+    if (argument >= end) return false;
+    const auto kind     = static_cast<TraceArgument> (*argument >> 4);
+    const size_t length = kind == TraceArgument::String ? (argument + 1 < end ? argument[1] : 0) : *argument & 0xF;
+    const uint8_t *data = argument + (kind == TraceArgument::String ? 2 : 1);
+    if (data + length > end || (length > 8 && kind != TraceArgument::String)) return false;
+    argument = data + length;
+
+    char text[64];
+    uint64_t raw = 0;
+    memcpy (&raw, data, kind == TraceArgument::String ? 0 : length);
+    switch (kind) {
+    case TraceArgument::Signed: {
+        // Sign extend from the stored width
+        const int64_t value = length < 8 ? static_cast<int64_t> (raw << (64 - length * 8)) >> (64 - length * 8) : static_cast<int64_t> (raw);
+        snprintf (text, sizeof (text), hex ? "%" PRIx64 : "%" PRId64, hex ? static_cast<uint64_t> (value) : value);
+        break;
+    }
+    case TraceArgument::Unsigned: snprintf (text, sizeof (text), hex ? "%" PRIx64 : "%" PRIu64, raw); break;
+    case TraceArgument::Float: {
+        double value;
+        if (length == sizeof (float)) {
+            float single;
+            memcpy (&single, data, sizeof (single));
+            value = single;
+        } else memcpy (&value, data, sizeof (value));
+        snprintf (text, sizeof (text), "%g", value);
+        break;
+    }
+    case TraceArgument::Bool: snprintf (text, sizeof (text), "%s", raw ? "true" : "false"); break;
+    case TraceArgument::Pointer: snprintf (text, sizeof (text), "0x%" PRIx64, raw); break;
+    case TraceArgument::String: out.append (reinterpret_cast<const char *> (data), length); return true;
+    default: return false;
+    }
+    out += text;
+    return true;
+}
+
+// Expands a std::format style format string with the arguments of one record
+static std::string
+Format (const char *format, const TraceRecord &record) {
+    std::string out;
+    const uint8_t *argument = record.arguments;
+    const uint8_t *end      = record.arguments + std::min<size_t> (record.size, TraceArgumentBytes);
+    for (const char *c = format; *c != '\0'; c++) {
+        if ((c[0] == '{' && c[1] == '{') || (c[0] == '}' && c[1] == '}')) out += *c++;
+        else if (c[0] == '{') {
+            const char *close = strchr (c, '}');
+            if (close == nullptr) break;
+            const bool hex = close > c + 1 && close[-1] == 'x';
+            if (!AppendArgument (out, argument, end, hex)) out += "<?>";
+            c = close;
+        } else out += *c;
+    }
+    return out;
+}
+
+int
+main (int argc, char **argv) {
+    if (argc != 2) {
+        fprintf (stderr, "Usage: tracedump <trace file>\n");
+        return 1;
+    }
+    std::ifstream file (argv[1], std::ios::binary);
+    const std::vector<char> contents ((std::istreambuf_iterator<char> (file)), std::istreambuf_iterator<char> ());
+    TraceHeader header;
+    if (contents.size () < sizeof (header)) {
+        fprintf (stderr, "%s is not a trace file\n", argv[1]);
+        return 1;
+    }
+    memcpy (&header, contents.data (), sizeof (header));
+    if (memcmp (header.magic, TraceMagic, sizeof (TraceMagic)) != 0 || header.version != TraceVersion || header.recordSize != sizeof (TraceRecord)
+        || header.frequency == 0) {
+        fprintf (stderr, "%s is not a version %u trace file\n", argv[1], TraceVersion);
+        return 1;
+    }
+    if (header.recordCount == 0 || header.recordOffset < sizeof (header) || header.recordOffset > contents.size ()) {
+        fprintf (stderr, "%s has a damaged header\n", argv[1]);
+        return 1;
+    }
+    const uint64_t count = std::min<uint64_t> (header.recordCount, (contents.size () - header.recordOffset) / sizeof (TraceRecord));
+
+    std::vector<TraceRecord> records;
+    records.reserve (count);
+    for (uint64_t i = 0; i < count; i++) {
+        TraceRecord record;
+        memcpy (&record, contents.data () + header.recordOffset + i * sizeof (TraceRecord), sizeof (record));
+        if (record.sequence != 0 && (record.sequence - 1) % header.recordCount == i && record.site != 0 && record.site <= header.siteCount)
+            records.push_back (record);
+    }
+    std::sort (records.begin (), records.end (), [] (const TraceRecord &a, const TraceRecord &b) { return a.sequence < b.sequence; });
+    if (header.head > records.size ()) printf ("%" PRIu64 " older or incomplete records were skipped\n", header.head - records.size ());
+
+    for (const auto &record : records) {
+        const TraceSiteEntry &site  = header.sites[record.site - 1];
+        const uint64_t microseconds = header.startTime + static_cast<uint64_t> (static_cast<double> (record.time) * 1000000 / header.frequency);
+        const time_t seconds        = static_cast<time_t> (microseconds / 1000000);
+        char timeStamp[32];
+        strftime (timeStamp, sizeof (timeStamp), "%Y/%m/%d %H:%M:%S", localtime (&seconds));
+
+        char file[TraceSiteFileSize + 1]     = {};
+        char format[TraceSiteFormatSize + 1] = {};
+        memcpy (file, site.file, sizeof (site.file));
+        memcpy (format, site.format, sizeof (site.format));
+        printf ("[%s.%06u] %5u %s:%u: %s\n", timeStamp, static_cast<unsigned> (microseconds % 1000000), record.thread, file, site.line,
+                Format (format, record).c_str ());
+    }
+    return 0;
+}
@@ -0,0 +1,149 @@
+#include <cstring>
+#include "usio.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+struct StoreHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t stateSize;
+    uint32_t reserved;
+};
+
+struct StoreSlot {
+    uint64_t generation;
+    uint64_t checksum;
+    UsioState state;
+};
+
+struct StoreFile {
+    StoreHeader header;
+    StoreSlot slots[2];
+};
+
+static constexpr StoreHeader currentHeader = {{'T', 'P', 'U', 'S'}, 1, sizeof (UsioState), 0};
+
+// FNV-1a over the generation and the state, a slot that was only partly written does not match
+static uint64_t
+Checksum (const uint64_t generation, const UsioState &state) {
+    uint64_t hash       = 14695981039346656037ull;
+    const auto hashData = [&] (const void *data, const size_t size) {
+        for (size_t i = 0; i < size; i++)
+            hash = (hash ^ static_cast<const uint8_t *> (data)[i]) * 1099511628211ull;
+    };
+    hashData (&generation, sizeof (generation));
+    hashData (&state, sizeof (state));
+    return hash;
+}
+
+bool
+UsioStore::Open (const char *path) {
+    this->Close ();
+    this->size = sizeof (StoreFile);
+    // Only a new, empty file is grown and given a header, anything else must already be a store of the current format
+    bool fresh = false, valid = false;
+    StoreHeader header{};
+#ifdef _WIN32
+    this->file = CreateFileA (path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (this->file == INVALID_HANDLE_VALUE) {
+        this->file = nullptr;
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (GetFileSizeEx (this->file, &fileSize)) {
+        DWORD read = 0;
+        fresh      = fileSize.QuadPart == 0;
+        if (fresh) valid = true;
+        else if (fileSize.QuadPart >= static_cast<LONGLONG> (this->size) && ReadFile (this->file, &header, sizeof (header), &read, nullptr))
+            valid = read == sizeof (header) && memcmp (&header, &currentHeader, sizeof (header)) == 0;
+    }
+    // The mapping grows a new file to the full size
+    if (valid) this->mapping = CreateFileMappingA (this->file, nullptr, PAGE_READWRITE, 0, static_cast<DWORD> (this->size), nullptr);
+    if (this->mapping != nullptr) this->view = MapViewOfFile (this->mapping, FILE_MAP_ALL_ACCESS, 0, 0, this->size);
+#else
+    const int fd = open (path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) return false;
+    if (struct stat info {}; fstat (fd, &info) == 0) {
+        fresh = info.st_size == 0;
+        if (fresh) valid = ftruncate (fd, static_cast<off_t> (this->size)) == 0;
+        else if (info.st_size >= static_cast<off_t> (this->size) && pread (fd, &header, sizeof (header), 0) == static_cast<ssize_t> (sizeof (header)))
+            valid = memcmp (&header, &currentHeader, sizeof (header)) == 0;
+    }
+    if (valid)
+        if (void *view = mmap (nullptr, this->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0); view != MAP_FAILED) this->view = view;
+    close (fd);
+#endif
+    if (this->view == nullptr) {
+        this->Close ();
+        return false;
+    }
+
+    auto *store = static_cast<StoreFile *> (this->view);
+    if (fresh) store->header = currentHeader;
+
+    const StoreSlot *newest = nullptr;
+    for (const auto &slot : store->slots)
+        if (slot.checksum == Checksum (slot.generation, slot.state) && (newest == nullptr || slot.generation > newest->generation)) newest = &slot;
+
+    std::lock_guard lock (this->mutex);
+    if (newest != nullptr) {
+        this->live       = newest->state;
+        this->generation = newest->generation;
+    } else {
+        this->live       = {};
+        this->generation = 0;
+    }
+    this->dirty.store (false, std::memory_order_relaxed);
+    return true;
+}
+
+void
+UsioStore::Flush () {
+    std::lock_guard flushLock (this->flushMutex);
+    if (this->view == nullptr || !this->dirty.exchange (false, std::memory_order_relaxed)) return;
+    {
+        std::lock_guard lock (this->mutex);
+        this->staging = this->live;
+    }
+    this->Commit (this->staging);
+}
+
+void
+UsioStore::Commit (const UsioState &state) {
+    // Always overwrite the older slot, the newest committed state stays untouched until this one is complete
+    const uint64_t generation = this->generation + 1;
+    StoreSlot &slot           = static_cast<StoreFile *> (this->view)->slots[generation % 2];
+    slot.state                = state;
+    slot.generation           = generation;
+    slot.checksum             = Checksum (generation, state);
+#ifdef _WIN32
+    FlushViewOfFile (&slot, sizeof (slot));
+    FlushFileBuffers (this->file);
+#else
+    msync (this->view, this->size, MS_SYNC);
+#endif
+    this->generation = generation;
+    this->commits.fetch_add (1, std::memory_order_relaxed);
+}
+
+void
+UsioStore::Close () {
+    if (this->view != nullptr) this->Flush ();
+#ifdef _WIN32
+    if (this->view != nullptr) UnmapViewOfFile (this->view);
+    if (this->mapping != nullptr) CloseHandle (this->mapping);
+    if (this->file != nullptr) CloseHandle (this->file);
+    this->mapping = nullptr;
+    this->file    = nullptr;
+#else
+    if (this->view != nullptr) munmap (this->view, this->size);
+#endif
+    this->view = nullptr;
+    this->size = 0;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+/* Everything the emulated USIO keeps across restarts. */
+struct UsioState {
+    uint32_t coins;
+    uint32_t services;
+    uint16_t registers16[256];
+    uint8_t registers8[256];
+    uint8_t sram[8192];
+};
+
+/* *
+ * USIO registers, SRAM and counters backed by a memory-mapped file.
+ *
+ * Writes only touch an in-memory copy and mark it dirty, Flush coalesces everything written since the last
+ * flush into one commit and may run on any thread. The file holds two slots that are written alternately,
+ * each with a generation and a checksum, so a crash while committing leaves the previous slot intact
+ * and Open picks the newest slot that is complete.
+ */
+class UsioStore {
+public:
+    ~UsioStore () { this->Close (); }
+
+    bool Open (const char *path);
+    void Flush ();
+    void Close ();
+    bool IsOpen () const { return this->view != nullptr; }
+
+    template <typename Function>
+    void
+    Modify (Function &&modify) {
+        std::lock_guard lock (this->mutex);
+        modify (this->live);
+        this->dirty.store (true, std::memory_order_relaxed);
+    }
+
+    template <typename Function>
+    auto
+    Read (Function &&read) {
+        std::lock_guard lock (this->mutex);
+        return read (static_cast<const UsioState &> (this->live));
+    }
+
+    uint64_t Generation () const { return this->generation; }
+    uint64_t Commits () const { return this->commits.load (std::memory_order_relaxed); }
+
+private:
+    void Commit (const UsioState &state);
+
+    std::mutex mutex;
+    UsioState live{};
+    std::atomic<bool> dirty{false};
+
+    std::mutex flushMutex;
+    UsioState staging{};
+    uint64_t generation = 0;
+    std::atomic<uint64_t> commits{0};
+
+    void *view  = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    void *file    = nullptr;
+    void *mapping = nullptr;
+#endif
+};
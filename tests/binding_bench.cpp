@@ -0,0 +1,183 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+#include "bindings.h"
+
+/* *
+ * Cost of evaluating the keybindings of one frame.
+ *
+ * The scan walks every slot of the binding arrays and tests each bound input on its own, the way
+ * GetInternalButtonState did before the bindings were compiled. The compiled path ORs the masks built
+ * by CompileBindings. Both read the same random InputState and must agree on every binding.
+ */
+static uint64_t
+Now () {
+    return std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now ().time_since_epoch ()).count ();
+}
+
+// Same layout as Keybindings, buttons are SDL_GameControllerButton values and -1 is unbound
+struct Bindings {
+    uint8_t keycodes[255];
+    int buttons[255];
+    SDLAxis axis[255];
+    Scroll scroll[2];
+    uint8_t buttonSlots[255];
+    uint8_t axisSlots[255];
+};
+
+// Entries the scan walked, the size of the US keyboard, controller button and axis name tables
+constexpr size_t ScannedKeycodes = 100;
+constexpr size_t ScannedButtons  = 21;
+constexpr size_t ScannedAxis     = 10;
+constexpr int ButtonCount        = 21;
+
+static bool
+TestBit (const uint64_t *bits, const uint32_t index) {
+    return (bits[index / 64] >> (index % 64)) & 1;
+}
+
+static InternalButtonState
+ScanBindings (const Bindings &bindings, const InputState &state) {
+    InternalButtonState buttons = {};
+
+    for (size_t i = 0; i < ScannedKeycodes; i++) {
+        const uint8_t keycode = bindings.keycodes[i];
+        if (keycode == 0) continue;
+        if (TestBit (state.released.keyboard, keycode)) buttons.Released = true;
+        if (TestBit (state.current.keyboard, keycode)) buttons.Down = 1;
+        if (TestBit (state.tapped.keyboard, keycode)) buttons.Tapped = true;
+    }
+    for (size_t i = 0; i < ScannedButtons; i++) {
+        const int button = bindings.buttons[i];
+        if (button < 0) continue;
+        for (uint8_t slots = BindingSlotMask (bindings.buttonSlots[i]), slot = 0; slot < MaxControllers; slot++) {
+            if (!(slots & (1u << slot))) continue;
+            if (TestBit (&state.released.buttons[slot], button)) buttons.Released = true;
+            if (TestBit (&state.current.buttons[slot], button)) buttons.Down = 1;
+            if (TestBit (&state.tapped.buttons[slot], button)) buttons.Tapped = true;
+        }
+    }
+    for (size_t i = 0; i < ScannedAxis; i++) {
+        const SDLAxis axis = bindings.axis[i];
+        if (axis == SDL_AXIS_NULL) continue;
+        for (uint8_t slots = BindingSlotMask (bindings.axisSlots[i]), slot = 0; slot < MaxControllers; slot++) {
+            if (!(slots & (1u << slot))) continue;
+            const float value = AxisValue (state.axis, axis, slot);
+            const float last  = AxisValue (state.lastAxis, axis, slot);
+            if (!value && last) buttons.Released = true;
+            if (value) buttons.Down = value;
+            if (value && !last) buttons.Tapped = true;
+        }
+    }
+    for (const Scroll scroll : bindings.scroll) {
+        if (scroll == MOUSE_SCROLL_INVALID) continue;
+        if (TestBit (&state.released.scroll, scroll)) buttons.Released = true;
+        if (TestBit (&state.current.scroll, scroll)) buttons.Down = 1;
+        if (TestBit (&state.tapped.scroll, scroll)) buttons.Tapped = true;
+    }
+
+    return buttons;
+}
+
+static uint32_t
+Random (uint32_t &seed) {
+    seed = seed * 1664525 + 1013904223;
+    return seed >> 8;
+}
+
+// A config worth of bindings: two keys and a button each, every fourth one also an axis and the first two the scroll wheel
+static void
+MakeBindings (Bindings *bindings, const size_t count) {
+    uint32_t seed = 7;
+    for (size_t i = 0; i < count; i++) {
+        Bindings &binding = bindings[i];
+        binding           = {};
+        std::fill (std::begin (binding.buttons), std::end (binding.buttons), -1);
+        binding.keycodes[0]    = static_cast<uint8_t> (1 + Random (seed) % 254);
+        binding.keycodes[1]    = static_cast<uint8_t> (1 + Random (seed) % 254);
+        binding.buttons[0]     = static_cast<int> (Random (seed) % ButtonCount);
+        binding.buttonSlots[0] = static_cast<uint8_t> (i % (MaxControllers + 1));
+        if (i % 4 == 0) {
+            binding.axis[0]      = static_cast<SDLAxis> (1 + Random (seed) % (SDL_AXIS_MAX - 1));
+            binding.axisSlots[0] = static_cast<uint8_t> (i / 4 % (MaxControllers + 1));
+        }
+        if (i < 2) binding.scroll[0] = i == 0 ? MOUSE_SCROLL_UP : MOUSE_SCROLL_DOWN;
+    }
+}
+
+// Flips a few inputs per frame so every binding sees presses, holds and releases
+static void
+NextFrame (InputState &state, uint32_t &seed) {
+    BeginInputFrame (state);
+    for (int i = 0; i < 8; i++) {
+        const uint32_t bit = Random (seed) % 256;
+        state.current.keyboard[bit / 64] ^= 1ull << (bit % 64);
+    }
+    for (uint8_t slot = 0; slot < MaxControllers; slot++) {
+        state.current.buttons[slot] ^= 1ull << (Random (seed) % ButtonCount);
+        const uint32_t axis           = 1 + Random (seed) % (SDL_AXIS_MAX - 1);
+        state.axis[slot].values[axis] = state.axis[slot].values[axis] ? 0 : static_cast<float> (Random (seed) % 100) / 100.0f;
+    }
+    state.current.scroll = Random (seed) % 3;
+    UpdateInputEdges (state);
+}
+
+template <typename Evaluate>
+static uint64_t
+TimeFrames (const std::vector<InputState> &frames, const size_t bindingCount, const uint64_t repeat, Evaluate evaluate) {
+    float down           = 0;
+    const uint64_t start = Now ();
+    for (uint64_t round = 0; round < repeat; round++)
+        for (const InputState &state : frames)
+            for (size_t i = 0; i < bindingCount; i++)
+                down += evaluate (i, state).Down;
+    const uint64_t elapsed = Now () - start;
+    // Keeps the evaluation from being optimized away
+    if (down < 0) puts ("");
+    return elapsed;
+}
+
+static void
+Benchmark (const size_t bindingCount) {
+    constexpr size_t MaxBindings = 32;
+    constexpr uint64_t Repeat    = 200;
+    Bindings bindings[MaxBindings];
+    CompiledBindings compiled[MaxBindings];
+    MakeBindings (bindings, bindingCount);
+    for (size_t i = 0; i < bindingCount; i++)
+        compiled[i] = CompileBindings (bindings[i], ButtonCount);
+
+    std::vector<InputState> frames (1024);
+    InputState state = {};
+    uint32_t seed    = 1;
+    for (InputState &frame : frames) {
+        NextFrame (state, seed);
+        frame = state;
+    }
+
+    uint64_t mismatches = 0;
+    for (const InputState &frame : frames)
+        for (size_t i = 0; i < bindingCount; i++) {
+            const auto [down, released, tapped] = ScanBindings (bindings[i], frame);
+            const InternalButtonState evaluated = EvaluateBindings (compiled[i], frame);
+            if (down != evaluated.Down || released != evaluated.Released || tapped != evaluated.Tapped) mismatches++;
+        }
+
+    const uint64_t scanTime
+        = TimeFrames (frames, bindingCount, Repeat, [&] (const size_t i, const InputState &frame) { return ScanBindings (bindings[i], frame); });
+    const uint64_t compiledTime
+        = TimeFrames (frames, bindingCount, Repeat, [&] (const size_t i, const InputState &frame) { return EvaluateBindings (compiled[i], frame); });
+    const double frameCount = static_cast<double> (frames.size () * Repeat);
+    printf ("%2zu bindings: scan %7.1f ns per frame, compiled %7.1f ns per frame, %llu mismatches\n", bindingCount,
+            static_cast<double> (scanTime) / frameCount, static_cast<double> (compiledTime) / frameCount,
+            static_cast<unsigned long long> (mismatches));
+}
+
+int
+main () {
+    Benchmark (4);
+    Benchmark (16);
+    Benchmark (32);
+    return 0;
+}
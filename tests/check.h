@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdio>
+
+/* *
+ * Assertions for the Linux tests of the portable modules.
+ *
+ * A failed check prints where it failed and the test keeps going, TEST_RESULT then fails the binary.
+ */
+inline int checkFailures = 0;
+
+#define CHECK(condition)                                                                    \
+    do {                                                                                    \
+        if (!(condition)) {                                                                 \
+            fprintf (stderr, "%s:%d: CHECK (%s) failed\n", __FILE__, __LINE__, #condition); \
+            checkFailures++;                                                                \
+        }                                                                                   \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                                                                                  \
+    do {                                                                                                                            \
+        const auto checkActual   = (actual);                                                                                        \
+        const auto checkExpected = (expected);                                                                                      \
+        if (!(checkActual == checkExpected)) {                                                                                      \
+            fprintf (stderr, "%s:%d: CHECK_EQ (%s, %s) failed, got %lld instead of %lld\n", __FILE__, __LINE__, #actual, #expected, \
+                     static_cast<long long> (checkActual), static_cast<long long> (checkExpected));                                 \
+            checkFailures++;                                                                                                        \
+        }                                                                                                                           \
+    } while (0)
+
+#define TEST_RESULT() (checkFailures == 0 ? 0 : (fprintf (stderr, "%d checks failed\n", checkFailures), 1))
+
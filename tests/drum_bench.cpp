@@ -0,0 +1,89 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "drum.h"
+
+/* *
+ * Cost of the drum hit pipeline per game poll.
+ *
+ * Scripted rolls are pushed and delivered like bnusio does once per frame for each pad,
+ * the result is the time spent per Push and Deliver pair. The velocity stream feeds a synthetic analog
+ * roll through the detector and the curve, the way UpdatePoll hands SDL axis events to them.
+ */
+static uint64_t
+Now () {
+    return std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now ().time_since_epoch ()).count ();
+}
+
+static void
+BenchmarkHitScheduler (const uint64_t frameTime, const uint64_t hitTime) {
+    HitScheduler scheduler;
+    scheduler.Configure (hitTime / 2, 16, DropPolicy::Oldest);
+    constexpr uint64_t Frames = 2000000;
+    uint64_t delivered = 0, nextHit = 0, pad = 0;
+
+    const uint64_t start = Now ();
+    for (uint64_t frame = 0; frame < Frames; frame++) {
+        const uint64_t now = frame * frameTime;
+        for (; nextHit <= now; nextHit += hitTime)
+            scheduler.Push ({nextHit, static_cast<uint8_t> (pad++ % 4)});
+        for (uint8_t i = 0; i < 4; i++)
+            if (DrumHit hit{}; scheduler.Deliver (i, now, hit)) delivered++;
+    }
+    const uint64_t elapsed = Now () - start;
+    printf ("HitScheduler, %3.0f fps, a hit every %5llu us: %6.1f ns per frame of 4 polls, %llu hits delivered, %llu dropped\n",
+            1000000.0 / static_cast<double> (frameTime), static_cast<unsigned long long> (hitTime),
+            static_cast<double> (elapsed) / Frames, static_cast<unsigned long long> (delivered),
+            static_cast<unsigned long long> (scheduler.Dropped ()));
+}
+
+// Decaying bursts of a pad being hit every hitTime microseconds, with some sensor noise
+static std::vector<float>
+SyntheticRoll (const uint64_t sampleTime, const uint64_t hitTime, const size_t count) {
+    std::vector<float> samples (count);
+    uint32_t noise = 1;
+    for (size_t i = 0; i < count; i++) {
+        const double sinceHit = static_cast<double> (i * sampleTime % hitTime);
+        noise                 = noise * 1664525 + 1013904223;
+        samples[i]            = static_cast<float> (0.8 * std::exp (-sinceHit / 2000.0) + (noise >> 24) / 25600.0);
+    }
+    return samples;
+}
+
+static void
+BenchmarkVelocityStream (const uint64_t sampleTime, const uint64_t hitTime) {
+    VelocityDetector detector;
+    detector.Configure (0.1f, 0.05f, 2000, 8000);
+    VelocityCurve curve;
+    curve.Build ({0, 20000, 32768});
+    const auto samples = SyntheticRoll (sampleTime, hitTime, 1 << 20);
+    constexpr size_t Rounds = 8;
+    uint64_t hits = 0, sum = 0;
+
+    const uint64_t start = Now ();
+    for (size_t round = 0; round < Rounds; round++) {
+        const uint64_t offset = round * samples.size () * sampleTime;
+        for (size_t i = 0; i < samples.size (); i++) {
+            const uint64_t now = offset + i * sampleTime;
+            detector.Feed (samples[i], now);
+            for (VelocityHit hit{}; detector.Poll (now, hit); hits++)
+                sum += curve.Map (hit.peak);
+        }
+    }
+    const uint64_t elapsed = Now () - start;
+    printf ("VelocityDetector, a sample every %4llu us, a hit every %5llu us: %5.1f ns per sample, %llu hits, mean velocity %llu\n",
+            static_cast<unsigned long long> (sampleTime), static_cast<unsigned long long> (hitTime),
+            static_cast<double> (elapsed) / (Rounds * samples.size ()), static_cast<unsigned long long> (hits),
+            static_cast<unsigned long long> (hits != 0 ? sum / hits : 0));
+}
+
+int
+main () {
+    BenchmarkHitScheduler (16667, 50000);
+    BenchmarkHitScheduler (16667, 4000);
+    BenchmarkHitScheduler (4167, 4000);
+    BenchmarkVelocityStream (1000, 50000);
+    BenchmarkVelocityStream (250, 12000);
+    return 0;
+}
@@ -0,0 +1,222 @@
+#include <vector>
+#include "check.h"
+#include "drum.h"
+
+// A game frame polling the four pads of one player in order, as bnusio_GetAnalogIn is called
+struct Delivery {
+    uint64_t frame;
+    uint8_t pad;
+    uint64_t timestamp;
+};
+
+static std::vector<Delivery>
+Play (HitScheduler &scheduler, const std::vector<DrumHit> &timeline, const uint64_t frameTime, const uint64_t frames) {
+    std::vector<Delivery> deliveries;
+    size_t next = 0;
+    for (uint64_t frame = 0; frame < frames; frame++) {
+        const uint64_t now = frame * frameTime;
+        while (next < timeline.size () && timeline[next].timestamp <= now)
+            scheduler.Push (timeline[next++]);
+        for (uint8_t pad = 0; pad < 4; pad++)
+            if (DrumHit hit{}; scheduler.Deliver (pad, now, hit)) deliveries.push_back ({frame, hit.pad, hit.timestamp});
+    }
+    return deliveries;
+}
+
+static void
+HitsKeepTheirOrderAcrossPads () {
+    HitScheduler scheduler;
+    scheduler.Configure (0, 16, DropPolicy::Oldest);
+    // Right pad before left pad within one frame, the left pad is polled first
+    const auto deliveries = Play (scheduler, {{1000, 3}, {2000, 0}}, 16667, 3);
+    CHECK_EQ (deliveries.size (), 2u);
+    CHECK_EQ (deliveries[0].pad, 3);
+    CHECK_EQ (deliveries[0].timestamp, 1000u);
+    CHECK_EQ (deliveries[1].pad, 0);
+    // Pad 0 was already polled when pad 3 was delivered, it waits for the next frame
+    CHECK_EQ (deliveries[1].frame, 2u);
+}
+
+// The interval is time based, the same roll comes out the same at 60 and 240 frames per second
+static void
+MinimumIntervalIsInMicroseconds () {
+    std::vector<DrumHit> roll;
+    for (uint64_t i = 0; i < 10; i++)
+        roll.push_back ({i * 5000, static_cast<uint8_t> (i % 2)});
+
+    for (const uint64_t frameTime : {16667u, 4167u}) {
+        HitScheduler scheduler;
+        scheduler.Configure (20000, 16, DropPolicy::Oldest);
+        const auto deliveries = Play (scheduler, roll, frameTime, 2000000 / frameTime);
+        CHECK_EQ (deliveries.size (), 10u);
+        for (size_t i = 1; i < deliveries.size (); i++)
+            CHECK (deliveries[i].frame * frameTime - deliveries[i - 1].frame * frameTime >= 20000);
+        for (size_t i = 0; i < deliveries.size (); i++)
+            CHECK_EQ (deliveries[i].timestamp, roll[i].timestamp);
+    }
+}
+
+static void
+BacklogDropsOldest () {
+    HitScheduler scheduler;
+    scheduler.Configure (0, 4, DropPolicy::Oldest);
+    for (uint64_t i = 0; i < 6; i++)
+        scheduler.Push ({i, 0});
+    CHECK_EQ (scheduler.Pending (), 4u);
+    CHECK_EQ (scheduler.Dropped (), 2u);
+    DrumHit hit{};
+    CHECK (scheduler.Deliver (0, 0, hit));
+    CHECK_EQ (hit.timestamp, 2u);
+}
+
+static void
+BacklogDropsNewest () {
+    HitScheduler scheduler;
+    scheduler.Configure (0, 4, DropPolicy::Newest);
+    for (uint64_t i = 0; i < 6; i++)
+        scheduler.Push ({i, 0});
+    CHECK_EQ (scheduler.Dropped (), 2u);
+    DrumHit hit{};
+    uint64_t last = 0;
+    while (scheduler.Deliver (0, 0, hit))
+        last = hit.timestamp;
+    CHECK_EQ (last, 3u);
+}
+
+static void
+BacklogIsClamped () {
+    HitScheduler scheduler;
+    scheduler.Configure (0, 100000, DropPolicy::Oldest);
+    CHECK_EQ (scheduler.Backlog (), MaxHitBacklog);
+    scheduler.Configure (0, 0, DropPolicy::Oldest);
+    CHECK_EQ (scheduler.Backlog (), 1u);
+}
+
+// Clearing forgets the last delivery, the next hit does not wait for the interval
+static void
+ClearResetsInterval () {
+    HitScheduler scheduler;
+    scheduler.Configure (50000, 16, DropPolicy::Oldest);
+    DrumHit hit{};
+    scheduler.Push ({0, 1});
+    CHECK (scheduler.Deliver (1, 0, hit));
+    scheduler.Push ({10, 1});
+    CHECK (!scheduler.Deliver (1, 10, hit));
+    scheduler.Clear ();
+    CHECK_EQ (scheduler.Pending (), 0u);
+    scheduler.Push ({20, 1});
+    CHECK (scheduler.Deliver (1, 20, hit));
+}
+
+// Feeds samples every step microseconds and collects the hits polled after each sample
+static std::vector<VelocityHit>
+Detect (VelocityDetector &detector, const std::vector<float> &samples, const uint64_t step) {
+    std::vector<VelocityHit> hits;
+    for (size_t i = 0; i < samples.size (); i++) {
+        detector.Feed (samples[i], i * step);
+        for (VelocityHit hit{}; detector.Poll (i * step, hit);)
+            hits.push_back (hit);
+    }
+    return hits;
+}
+
+static void
+VelocityLatchesPeakOfWindow () {
+    VelocityDetector detector;
+    detector.Configure (0.1f, 0.05f, 3000, 3000);
+    const auto hits = Detect (detector, {0, 0.2f, 0.6f, 0.9f, 0.4f, 0.95f, 0, 0}, 1000);
+    CHECK_EQ (hits.size (), 1u);
+    CHECK_EQ (hits[0].timestamp, 1000u);
+    // The sample at 5000 came after the window closed at 4000
+    CHECK (hits[0].peak == 0.9f);
+}
+
+// Sustained pressure after the lockout does not start another hit until the signal is released
+static void
+VelocityWaitsForRelease () {
+    VelocityDetector detector;
+    detector.Configure (0.1f, 0.05f, 1000, 2000);
+    const auto held = Detect (detector, {0.5f, 0.5f, 0.5f, 0.5f, 0.5f, 0.5f}, 1000);
+    CHECK_EQ (held.size (), 1u);
+
+    detector.Clear ();
+    const auto released = Detect (detector, {0.5f, 0.5f, 0, 0, 0.5f, 0.5f, 0}, 1000);
+    CHECK_EQ (released.size (), 2u);
+    if (released.size () == 2) CHECK_EQ (released[1].timestamp, 4000u);
+}
+
+// Regression: a hit arriving on the sample that ends the lockout used to be dropped
+static void
+VelocityOnsetAtLockoutEnd () {
+    VelocityDetector detector;
+    detector.Configure (0.1f, 0.05f, 1000, 3000);
+    const auto hits = Detect (detector, {0.5f, 0.5f, 0, 0.5f, 0}, 1000);
+    CHECK_EQ (hits.size (), 2u);
+    if (hits.size () == 2) CHECK_EQ (hits[1].timestamp, 3000u);
+}
+
+static void
+VelocityCurveInterpolates () {
+    VelocityCurve curve;
+    CHECK_EQ (curve.Map (0), 0u);
+    CHECK_EQ (curve.Map (1), 32768u);
+    CHECK_EQ (curve.Map (0.5f), 16448u);
+    // Out of range peaks are clamped
+    CHECK_EQ (curve.Map (-1), 0u);
+    CHECK_EQ (curve.Map (2), 32768u);
+
+    curve.Build ({0, 60000, 60000});
+    CHECK_EQ (curve.Map (0.5f), 60000u);
+    CHECK_EQ (curve.Map (1), 60000u);
+    // Values past the 16 bit range saturate
+    curve.Build ({-100, 100000});
+    CHECK_EQ (curve.Map (0), 0u);
+    CHECK_EQ (curve.Map (1), 65535u);
+    // Fewer than two points fall back to the linear default
+    curve.Build ({5});
+    CHECK_EQ (curve.Map (1), 32768u);
+}
+
+// bnusio_GetAnalogIn polls the drum several times per game frame, each tap must reach the scheduler once
+static void
+PadTapsQueueEachFrameOnce () {
+    HitScheduler schedulers[2];
+    for (HitScheduler &scheduler : schedulers)
+        scheduler.Configure (0, 16, DropPolicy::Oldest);
+    PadTaps taps;
+
+    // Bindings 3 and 4 are P1_LEFT_BLUE and P1_LEFT_RED, binding 9 is P2_RIGHT_RED
+    const LogicalInputFrame frame{1, 0, 1u << 3 | 1u << 4 | 1u << 9, 0};
+    for (int poll = 0; poll < 4; poll++)
+        taps.Queue (frame, 3, 1000, schedulers);
+    CHECK_EQ (schedulers[0].Pending (), 2u);
+    CHECK_EQ (schedulers[1].Pending (), 1u);
+
+    DrumHit hit{};
+    CHECK (schedulers[1].Deliver (2, 1000, hit));
+    CHECK_EQ (hit.pad, 2);
+
+    // The same tap bits in the next frame are a new tap
+    taps.Queue ({2, 0, 1u << 3, 0}, 3, 2000, schedulers);
+    CHECK_EQ (schedulers[0].Pending (), 3u);
+    // The empty frame before the first poll queues nothing
+    PadTaps fresh;
+    fresh.Queue ({0, 0, ~0u, 0}, 3, 0, schedulers);
+    CHECK_EQ (schedulers[0].Pending (), 3u);
+}
+
+int
+main () {
+    HitsKeepTheirOrderAcrossPads ();
+    MinimumIntervalIsInMicroseconds ();
+    BacklogDropsOldest ();
+    BacklogDropsNewest ();
+    BacklogIsClamped ();
+    ClearResetsInterval ();
+    VelocityLatchesPeakOfWindow ();
+    VelocityWaitsForRelease ();
+    VelocityOnsetAtLockoutEnd ();
+    VelocityCurveInterpolates ();
+    PadTapsQueueEachFrameOnce ();
+    return TEST_RESULT ();
+}
@@ -0,0 +1,86 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+#include "eventbus.h"
+
+/* *
+ * Throughput of plugins publishing commits to the loader through the event bus.
+ *
+ * Producers acquire, fill and publish slots in place while one consumer drains them, against a mutex guarded
+ * std::queue of copied events as the baseline. The result is the time per event at the consumer.
+ */
+static uint64_t
+Now () {
+    return std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now ().time_since_epoch ()).count ();
+}
+
+constexpr uint64_t Events = 2000000;
+
+template <typename Produce, typename Drain>
+static void
+Benchmark (const char *name, const uint32_t producers, Produce produce, Drain drain) {
+    std::atomic<bool> go{false};
+    std::vector<std::thread> threads;
+    for (uint32_t i = 0; i < producers; i++)
+        threads.emplace_back ([&, i] {
+            while (!go.load (std::memory_order_acquire)) std::this_thread::yield ();
+            for (uint64_t n = 0; n < Events / producers;)
+                if (produce (i, n)) n++;
+                else std::this_thread::yield ();
+        });
+
+    const uint64_t start = Now ();
+    go.store (true, std::memory_order_release);
+    uint64_t received = 0, sum = 0;
+    while (received < Events / producers * producers)
+        if (const size_t count = drain (sum)) received += count;
+        else std::this_thread::yield ();
+    const uint64_t elapsed = Now () - start;
+    for (auto &thread : threads)
+        thread.join ();
+    printf ("%-28s %u producers: %6.1f ns per event (checksum %llu)\n", name, producers, static_cast<double> (elapsed) / received,
+            static_cast<unsigned long long> (sum));
+}
+
+int
+main () {
+    for (const uint32_t producers : {1u, 2u, 4u}) {
+        static EventBus bus;
+        Benchmark (
+            "EventBus acquire/publish", producers,
+            [] (const uint32_t producer, const uint64_t n) {
+                BusEvent *event = bus.Acquire (BusEventType::CardCommit);
+                if (event == nullptr) return false;
+                event->coin = {producer, static_cast<uint32_t> (n)};
+                bus.Publish (event);
+                return true;
+            },
+            [] (uint64_t &sum) { return bus.Drain ([&] (const BusEvent &event) { sum += event.coin.services; }); });
+
+        std::mutex mutex;
+        std::queue<BusEvent> queue;
+        Benchmark (
+            "std::mutex + std::queue", producers,
+            [&] (const uint32_t producer, const uint64_t n) {
+                BusEvent event{};
+                event.type = BusEventType::CardCommit;
+                event.coin = {producer, static_cast<uint32_t> (n)};
+                std::lock_guard lock (mutex);
+                if (queue.size () >= EventBus::SlotCount) return false;
+                queue.push (event);
+                return true;
+            },
+            [&] (uint64_t &sum) {
+                std::lock_guard lock (mutex);
+                const size_t count = queue.size ();
+                for (; !queue.empty (); queue.pop ())
+                    sum += queue.front ().coin.services;
+                return count;
+            });
+    }
+    return 0;
+}
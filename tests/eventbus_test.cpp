@@ -0,0 +1,138 @@
+#include <thread>
+#include <vector>
+#include "check.h"
+#include "eventbus.h"
+
+static void
+CountEvent (const BusEvent *event, void *context) {
+    *static_cast<uint64_t *> (context) += event->frame.frame;
+}
+
+static void
+DispatchReachesSubscribersOfType () {
+    EventBus bus;
+    uint64_t first = 0, second = 0, coins = 0;
+    CHECK (bus.Subscribe (BusEventType::Frame, CountEvent, &first));
+    CHECK (bus.Subscribe (BusEventType::Frame, CountEvent, &second));
+    CHECK (bus.Subscribe (BusEventType::Coin, CountEvent, &coins));
+    CHECK (!bus.Subscribe (BusEventType::Count, CountEvent, &coins));
+    CHECK (!bus.Subscribe (BusEventType::Frame, nullptr, nullptr));
+    CHECK (bus.HasSubscribers (BusEventType::Frame));
+    CHECK (!bus.HasSubscribers (BusEventType::Input));
+
+    BusEvent event{};
+    event.type        = BusEventType::Frame;
+    event.frame.frame = 3;
+    bus.Dispatch (event);
+    CHECK_EQ (first, 3u);
+    CHECK_EQ (second, 3u);
+    CHECK_EQ (coins, 0u);
+}
+
+static void
+SubscribersAreBounded () {
+    EventBus bus;
+    uint64_t count = 0;
+    for (size_t i = 0; i < EventBus::MaxSubscribers; i++)
+        CHECK (bus.Subscribe (BusEventType::Frame, CountEvent, &count));
+    CHECK (!bus.Subscribe (BusEventType::Frame, CountEvent, &count));
+}
+
+// Only the commits plugins send to the loader can be acquired
+static void
+AcquireRejectsLoaderEvents () {
+    EventBus bus;
+    CHECK (bus.Acquire (BusEventType::Frame) == nullptr);
+    CHECK (bus.Acquire (BusEventType::Input) == nullptr);
+    BusEvent *event = bus.Acquire (BusEventType::CardCommit);
+    CHECK (event != nullptr);
+    if (event != nullptr) CHECK (event->type == BusEventType::CardCommit);
+    bus.Publish (event);
+    CHECK_EQ (bus.Drain ([] (const BusEvent &) {}), 1u);
+}
+
+// A slot committed out of order waits for the older ones, the consumer never sees a slot still being filled
+static void
+CommitsAreConsumedInClaimOrder () {
+    MpscRing<int, 4> ring;
+    size_t first, second;
+    int *a = ring.Claim (first);
+    int *b = ring.Claim (second);
+    CHECK (a != nullptr && b != nullptr);
+    if (a == nullptr || b == nullptr) return;
+    *a = 1;
+    *b = 2;
+    ring.Commit (second);
+    int value = 0;
+    CHECK (!ring.Pop (value));
+    ring.Commit (first);
+    CHECK (ring.Pop (value));
+    CHECK_EQ (value, 1);
+    CHECK (ring.Consume ([&] (const int &item) { value = item; }));
+    CHECK_EQ (value, 2);
+    CHECK (!ring.Pop (value));
+}
+
+static void
+FullRingCountsDrops () {
+    EventBus bus;
+    std::vector<BusEvent *> events;
+    for (size_t i = 0; i < EventBus::SlotCount; i++)
+        events.push_back (bus.Acquire (BusEventType::QrCommit));
+    CHECK (events.back () != nullptr);
+    CHECK (bus.Acquire (BusEventType::QrCommit) == nullptr);
+    CHECK_EQ (bus.Dropped (), 1u);
+    for (BusEvent *event : events)
+        bus.Publish (event);
+    CHECK_EQ (bus.Drain ([] (const BusEvent &) {}), EventBus::SlotCount);
+    // Draining frees the slots again
+    CHECK (bus.Acquire (BusEventType::QrCommit) != nullptr);
+}
+
+// Several plugin threads publishing while the game thread drains, nothing is lost, duplicated or reordered per thread
+static void
+ProducersKeepTheirOrder () {
+    constexpr uint32_t Producers = 4;
+    constexpr uint32_t PerThread = 20000;
+    static EventBus bus;
+    std::vector<std::thread> threads;
+    for (uint32_t producer = 0; producer < Producers; producer++)
+        threads.emplace_back ([producer] {
+            for (uint32_t i = 0; i < PerThread;) {
+                BusEvent *event = bus.Acquire (BusEventType::CardCommit);
+                if (event == nullptr) {
+                    std::this_thread::yield ();
+                    continue;
+                }
+                event->coin = {producer, i++};
+                bus.Publish (event);
+            }
+        });
+
+    uint32_t next[Producers] = {};
+    uint64_t received = 0, outOfOrder = 0;
+    while (received < Producers * PerThread) {
+        const size_t count = bus.Drain ([&] (const BusEvent &event) {
+            if (event.coin.coins >= Producers || event.coin.services != next[event.coin.coins]++) outOfOrder++;
+        });
+        if (count == 0) std::this_thread::yield ();
+        received += count;
+    }
+    for (auto &thread : threads)
+        thread.join ();
+    CHECK_EQ (outOfOrder, 0u);
+    for (const uint32_t count : next)
+        CHECK_EQ (count, PerThread);
+    CHECK_EQ (bus.Drain ([] (const BusEvent &) {}), 0u);
+}
+
+int
+main () {
+    DispatchReachesSubscribersOfType ();
+    SubscribersAreBounded ();
+    AcquireRejectsLoaderEvents ();
+    CommitsAreConsumedInClaimOrder ();
+    FullRingCountsDrops ();
+    ProducersKeepTheirOrder ();
+    return TEST_RESULT ();
+}
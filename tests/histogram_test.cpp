@@ -0,0 +1,80 @@
+#include <thread>
+#include <vector>
+#include "check.h"
+#include "histogram.h"
+
+static void
+EmptyHistogram () {
+    Histogram histogram;
+    CHECK_EQ (histogram.Count (), 0u);
+    CHECK_EQ (histogram.Percentile (99), 0u);
+}
+
+// Below 8 every value has its own bucket
+static void
+SmallValuesAreExact () {
+    Histogram histogram;
+    for (uint64_t value = 0; value < 8; value++)
+        histogram.Record (value);
+    CHECK_EQ (histogram.Percentile (50), 3u);
+    CHECK_EQ (histogram.Percentile (100), 7u);
+    CHECK_EQ (histogram.Max (), 7u);
+}
+
+static void
+PercentilesStayWithinABucket () {
+    Histogram histogram;
+    for (uint64_t value = 1; value <= 10000; value++)
+        histogram.Record (value);
+    for (const double percentile : {50.0, 90.0, 99.0, 99.9}) {
+        const double exact    = percentile * 100;
+        const double reported = static_cast<double> (histogram.Percentile (percentile));
+        CHECK (reported >= exact && reported <= exact * 1.125);
+    }
+    CHECK_EQ (histogram.Percentile (100), 10000u);
+}
+
+// The top bucket would overshoot the largest value, it is capped to Max
+static void
+PercentileIsCappedToMax () {
+    Histogram histogram;
+    histogram.Record (1000);
+    CHECK_EQ (histogram.Percentile (50), 1000u);
+    histogram.Record (UINT64_MAX);
+    CHECK_EQ (histogram.Percentile (100), UINT64_MAX);
+}
+
+static void
+Reset () {
+    Histogram histogram;
+    histogram.Record (42);
+    histogram.Reset ();
+    CHECK_EQ (histogram.Count (), 0u);
+    CHECK_EQ (histogram.Max (), 0u);
+}
+
+static void
+ConcurrentRecords () {
+    Histogram histogram;
+    std::vector<std::thread> threads;
+    for (uint64_t thread = 0; thread < 4; thread++)
+        threads.emplace_back ([&histogram, thread] {
+            for (uint64_t i = 0; i < 100000; i++)
+                histogram.Record (thread * 100000 + i);
+        });
+    for (auto &thread : threads)
+        thread.join ();
+    CHECK_EQ (histogram.Count (), 400000u);
+    CHECK_EQ (histogram.Max (), 399999u);
+}
+
+int
+main () {
+    EmptyHistogram ();
+    SmallValuesAreExact ();
+    PercentilesStayWithinABucket ();
+    PercentileIsCappedToMax ();
+    Reset ();
+    ConcurrentRecords ();
+    return TEST_RESULT ();
+}
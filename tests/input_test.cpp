@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <iterator>
+#include "bindings.h"
+#include "check.h"
+#include "input.h"
+
+/* *
+ * The keyboard half of UpdatePoll without a window: a SyntheticBackend feeds the InputState,
+ * the bindings are evaluated into a LogicalInputChannel the way PublishLogicalInput does.
+ */
+struct Bindings {
+    uint8_t keycodes[255];
+    int buttons[255];
+    SDLAxis axis[255];
+    Scroll scroll[2];
+    uint8_t buttonSlots[255];
+    uint8_t axisSlots[255];
+};
+
+class Poll {
+public:
+    Poll (const std::initializer_list<std::initializer_list<uint8_t>> keys) {
+        uint64_t watched[4] = {};
+        for (const auto &binding : keys) {
+            Bindings bindings = {};
+            std::fill (std::begin (bindings.buttons), std::end (bindings.buttons), -1);
+            std::copy (binding.begin (), binding.end (), bindings.keycodes);
+            this->compiled[this->count] = CompileBindings (bindings, 21);
+            for (size_t i = 0; i < std::size (watched); i++)
+                watched[i] |= this->compiled[this->count].keyboard[i];
+            this->count++;
+        }
+        this->backend.Watch (watched);
+    }
+
+    LogicalInputFrame
+    Update () {
+        BeginInputFrame (this->state);
+        this->backend.Read (this->state.current.keyboard);
+        UpdateInputEdges (this->state);
+
+        uint32_t down = 0, tapped = 0, released = 0;
+        for (size_t i = 0; i < this->count; i++) {
+            const auto [Down, Released, Tapped] = EvaluateBindings (this->compiled[i], this->state);
+            down |= static_cast<uint32_t> (Down >= 1.0f) << i;
+            tapped |= static_cast<uint32_t> (Tapped) << i;
+            released |= static_cast<uint32_t> (Released) << i;
+        }
+        this->channel.Publish (down, tapped, released);
+        return this->channel.Load ();
+    }
+
+    SyntheticBackend backend;
+
+private:
+    CompiledBindings compiled[MaxLogicalBindings] = {};
+    size_t count                                  = 0;
+    InputState state                              = {};
+    LogicalInputChannel channel;
+};
+
+// Pressed and released between two polls, the binding is still down and tapped for one frame
+static void
+ShortTapIsNotLost () {
+    Poll poll ({{'A'}});
+    poll.backend.Press ('A');
+    poll.backend.Release ('A');
+    const LogicalInputFrame tap = poll.Update ();
+    CHECK (tap.Down (0));
+    CHECK (tap.Tapped (0));
+    CHECK (!tap.Released (0));
+
+    const LogicalInputFrame after = poll.Update ();
+    CHECK (!after.Down (0));
+    CHECK (after.Released (0));
+    CHECK (!after.Tapped (0));
+}
+
+static void
+HeldKeyTapsOnce () {
+    Poll poll ({{'A'}});
+    poll.backend.Press ('A');
+    CHECK (poll.Update ().Tapped (0));
+    for (int frame = 0; frame < 3; frame++) {
+        const LogicalInputFrame held = poll.Update ();
+        CHECK (held.Down (0));
+        CHECK (!held.Tapped (0));
+        CHECK (!held.Released (0));
+    }
+    poll.backend.Release ('A');
+    CHECK (poll.Update ().Released (0));
+    CHECK_EQ (poll.Update ().down, 0u);
+}
+
+// Any key of a binding holds it, a key released while another one is pressed still releases the binding
+static void
+BindingsShareKeys () {
+    Poll poll ({{'A', 'B'}, {'B'}, {0xBA}});
+    poll.backend.Press ('A');
+    poll.backend.Press (0xBA);
+    const LogicalInputFrame first = poll.Update ();
+    CHECK_EQ (first.down, 0b101u);
+    CHECK_EQ (first.tapped, 0b101u);
+
+    poll.backend.Press ('B');
+    poll.backend.Release ('A');
+    const LogicalInputFrame second = poll.Update ();
+    CHECK_EQ (second.down, 0b111u);
+    CHECK_EQ (second.tapped, 0b011u);
+    CHECK_EQ (second.released, 0b001u);
+}
+
+// Keys no binding uses never reach the poll state
+static void
+UnwatchedKeysAreIgnored () {
+    Poll poll ({{'A'}});
+    poll.backend.Press ('Z');
+    poll.backend.Press (' ');
+    const LogicalInputFrame frame = poll.Update ();
+    CHECK_EQ (frame.down, 0u);
+    CHECK_EQ (frame.tapped, 0u);
+}
+
+static void
+EveryUpdatePublishesOneFrame () {
+    Poll poll ({{'A'}});
+    const uint64_t first = poll.Update ().sequence;
+    CHECK_EQ (poll.Update ().sequence, first + 1);
+    CHECK_EQ (poll.Update ().sequence, first + 2);
+}
+
+int
+main () {
+    ShortTapIsNotLost ();
+    HeldKeyTapsOnce ();
+    BindingsShareKeys ();
+    UnwatchedKeysAreIgnored ();
+    EveryUpdatePublishesOneFrame ();
+    return TEST_RESULT ();
+}
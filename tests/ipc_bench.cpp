@@ -0,0 +1,61 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "ipc_host.h"
+
+/* *
+ * Round trip latency between the loader and the plugin host process.
+ *
+ * A card wait event goes to a forked stand-in host, which answers with a card commit through its own event bus,
+ * like a hosted card reader plugin. Pipelined requests measure how many round trips the channel carries per second.
+ */
+static uint64_t
+Now () {
+    return std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now ().time_since_epoch ()).count ();
+}
+
+int
+main () {
+    const std::string name = "ipc_bench." + std::to_string (getpid ());
+    IpcChannel channel;
+    if (!channel.Create (name.c_str ())) {
+        fprintf (stderr, "Failed to create channel %s\n", name.c_str ());
+        return 1;
+    }
+    const pid_t host = StandInHost::Start (name);
+    BusEvent request{};
+    request.type = BusEventType::CardWait;
+
+    // One request at a time, the host sleeps in between
+    constexpr size_t RoundTrips = 20000;
+    std::vector<uint64_t> latencies;
+    latencies.reserve (RoundTrips);
+    for (size_t i = 0; i < RoundTrips; i++) {
+        const uint64_t start = Now ();
+        channel.Send (request);
+        while (channel.Receive ([] (const BusEvent &) {}) == 0)
+            channel.Wait (1000000);
+        latencies.push_back (Now () - start);
+    }
+    std::sort (latencies.begin (), latencies.end ());
+    printf ("Round trip: p50 %6.2f us, p99 %6.2f us, max %8.2f us\n", latencies[RoundTrips / 2] / 1000.0, latencies[RoundTrips * 99 / 100] / 1000.0,
+            latencies.back () / 1000.0);
+
+    // Keeping as many requests in flight as the host bus has slots for commits
+    constexpr size_t Pipelined = 1000000;
+    size_t sent = 0, received = 0;
+    const uint64_t start = Now ();
+    while (received < Pipelined) {
+        while (sent < Pipelined && sent - received < EventBus::SlotCount && channel.Send (request)) sent++;
+        const size_t count = channel.Receive ([] (const BusEvent &) {});
+        if (count == 0) channel.Wait (1000000);
+        received += count;
+    }
+    printf ("Pipelined: %6.2f million round trips per second\n", Pipelined * 1000.0 / static_cast<double> (Now () - start));
+
+    channel.Shutdown ();
+    StandInHost::Join (host);
+    return 0;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdio>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "eventbus.h"
+#include "ipc.h"
+
+/* *
+ * Stand-in for TaikoPluginHost on Linux, forked by the IPC test and benchmark.
+ *
+ * Runs the main loop of src/host/main.cpp with one built in plugin instead of loaded ones: every CardWait
+ * event it receives is answered with a CardCommit carrying the sequence of the request in its chip id.
+ */
+namespace StandInHost {
+inline EventBus bus;
+inline IpcChannel channel;
+
+inline void
+AnswerCardWait (const BusEvent *event, void *) {
+    BusEvent *commit = bus.Acquire (BusEventType::CardCommit);
+    if (commit == nullptr) return;
+    snprintf (commit->card.accessCode, sizeof (commit->card.accessCode), "00000000000000000000");
+    snprintf (commit->card.chipId, sizeof (commit->card.chipId), "%llu", static_cast<unsigned long long> (event->status.active));
+    bus.Publish (commit);
+    channel.Interrupt ();
+}
+
+inline int
+Run (const std::string &name) {
+    if (!channel.Open (name.c_str ())) return 1;
+    bus.Subscribe (BusEventType::CardWait, AnswerCardWait, nullptr);
+    while (!channel.IsShutdown () && getppid () != 1) {
+        channel.Wait (100000);
+        channel.Receive ([] (const BusEvent &event) { bus.Dispatch (event); });
+        bus.Drain ([] (const BusEvent &event) { channel.Send (event); });
+    }
+    channel.Close ();
+    return 0;
+}
+
+// Forks the host once the channel was created, returns its pid
+inline pid_t
+Start (const std::string &name) {
+    const pid_t pid = fork ();
+    if (pid == 0) _exit (Run (name));
+    return pid;
+}
+
+inline int
+Join (const pid_t pid) {
+    int status = 0;
+    waitpid (pid, &status, 0);
+    return WIFEXITED (status) ? WEXITSTATUS (status) : -1;
+}
+} // namespace StandInHost
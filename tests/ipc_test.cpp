@@ -0,0 +1,69 @@
+#include <cstdlib>
+#include <string>
+#include "check.h"
+#include "ipc_host.h"
+
+static const std::string name = "ipc_test." + std::to_string (getpid ());
+
+static BusEvent
+CardWait (const uint32_t sequence) {
+    BusEvent event{};
+    event.type          = BusEventType::CardWait;
+    event.status.active = sequence;
+    return event;
+}
+
+static void
+OpenNeedsACreatedChannel () {
+    IpcChannel channel;
+    CHECK (!channel.Open ("ipc_test.missing"));
+    CHECK (!channel.IsOpen ());
+}
+
+// Nobody receives, so the ring fills up and further sends are dropped instead of blocking
+static void
+FullRingDrops () {
+    IpcChannel channel;
+    CHECK (channel.Create (name.c_str ()));
+    for (size_t i = 0; i < IpcChannel::SlotCount; i++)
+        CHECK (channel.Send (CardWait (0)));
+    CHECK (!channel.Send (CardWait (0)));
+    CHECK_EQ (channel.Dropped (), 1u);
+    // Nothing came back, Wait gives up after its timeout
+    CHECK (!channel.Wait (1000));
+}
+
+// Every request is answered once and in order by the host process
+static void
+HostAnswersInOrder () {
+    IpcChannel channel;
+    CHECK (channel.Create (name.c_str ()));
+    const pid_t host = StandInHost::Start (name);
+
+    constexpr uint32_t Requests = 2000;
+    uint32_t sent = 0, received = 0, wrong = 0;
+    // The host bus holds as many commits as it has slots, more requests in flight would be dropped there
+    while (received < Requests) {
+        while (sent < Requests && sent - received < EventBus::SlotCount && channel.Send (CardWait (sent))) sent++;
+        if (!channel.Wait (1000000)) break;
+        channel.Receive ([&] (const BusEvent &event) {
+            if (event.type != BusEventType::CardCommit || strtoul (event.card.chipId, nullptr, 10) != received) wrong++;
+            received++;
+        });
+    }
+    CHECK_EQ (received, Requests);
+    CHECK_EQ (wrong, 0u);
+
+    // Shutting the channel down wakes the host, which exits cleanly
+    channel.Shutdown ();
+    CHECK_EQ (StandInHost::Join (host), 0);
+    CHECK (channel.IsShutdown ());
+}
+
+int
+main () {
+    OpenNeedsACreatedChannel ();
+    FullRingDrops ();
+    HostAnswersInOrder ();
+    return TEST_RESULT ();
+}
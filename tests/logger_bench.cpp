@@ -0,0 +1,157 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "logger.h"
+
+/* *
+ * Cost of a log call on the calling thread, and how long the whole burst takes to reach the console and the file.
+ *
+ * The current logger queues records for its writer thread. The old handler is kept below as it was before, formatting
+ * into a std::string, shortening the function name with a regex and writing and flushing under a mutex on the caller.
+ * Only the Windows console calls are replaced with ANSI colors and GetSystemTime with the system clock.
+ * The console goes to /dev/null and the log file into a temporary directory.
+ */
+namespace Old {
+static FILE *logFile = nullptr;
+static LogLevel logLevel;
+static std::mutex logMutex;
+
+static void
+LogMessageHandler (const char *function, const char *codeFile, int codeLine, LogLevel messageLevel, const char *format, ...) {
+    if (messageLevel > logLevel) return;
+    std::lock_guard lock (logMutex);
+
+    va_list args;
+    va_start (args, format);
+    va_list copy;
+    va_copy (copy, args);
+    int requiredSize = vsnprintf (nullptr, 0, format, args) + 1;
+    std::unique_ptr<char[]> buffer (new char[requiredSize]);
+    vsnprintf (buffer.get (), requiredSize, format, copy);
+    std::string formattedMessage (buffer.get ());
+    va_end (copy);
+    va_end (args);
+
+    std::string logType = GetLogLevelString (messageLevel);
+
+    std::string short_function (function);
+    std::regex re (R"(.*? (([\w<>]+::)*[\w]+( [()<>+-]+)?)\(\w+.*?\))");
+    short_function = std::regex_replace (short_function, re, "$1");
+
+    constexpr std::string_view build_dir = XSTRING (SOURCE_ROOT);
+    std::string_view filename            = codeFile;
+    filename.remove_prefix (std::min (build_dir.size (), filename.size ()));
+
+    const auto now = std::chrono::system_clock::now ();
+    time_t rawTime = std::chrono::system_clock::to_time_t (now);
+    tm *timeInfo   = localtime (&rawTime);
+    std::ostringstream timeStamp;
+    timeStamp << std::put_time (timeInfo, "%Y/%m/%d %H:%M:%S") << "." << std::setw (3) << std::setfill ('0')
+              << std::chrono::duration_cast<std::chrono::milliseconds> (now.time_since_epoch ()).count () % 1000;
+
+    std::ostringstream logStream;
+    logStream << short_function << " (" << filename << ":" << codeLine << "): " << formattedMessage;
+    std::string logMessage = logStream.str ();
+
+    std::cout << "[" << timeStamp.str () << "] ";
+    std::cout << "\033[" << GetLogLevelColor (messageLevel) << 'm' << logType << "\033[0m";
+    std::cout << logMessage << std::endl;
+    std::cout.flush ();
+
+    if (logFile != nullptr) {
+        fprintf (logFile, "[%s] %s%s\n", timeStamp.str ().c_str (), logType.c_str (), logMessage.c_str ());
+        fflush (logFile);
+    }
+}
+
+template <typename... Args>
+struct LogMessage {
+    LogMessage (const LogLevel level, const std::string_view format, Args &&...args,
+                const std::source_location &loc = std::source_location::current ()) {
+        std::string formatted_message = std::vformat (std::string (format), std::make_format_args (args...));
+        LogMessageHandler (loc.function_name (), loc.file_name (), loc.line (), level, formatted_message.c_str ());
+    }
+};
+
+template <typename... Args>
+LogMessage (LogLevel level, std::string_view format, Args &&...ts) -> LogMessage<Args...>;
+} // namespace Old
+
+static uint64_t
+Now () {
+    return std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now ().time_since_epoch ()).count ();
+}
+
+constexpr int Messages = 20000;
+
+// A hook logging from the game thread, with the short pauses of a frame in between
+template <typename Log>
+static std::vector<uint64_t>
+Burst (Log log, const int thread) {
+    std::vector<uint64_t> latencies (Messages);
+    for (int i = 0; i < Messages; i++) {
+        const uint64_t start = Now ();
+        log (thread, i);
+        latencies[i] = Now () - start;
+        if (i % 64 == 0) std::this_thread::sleep_for (std::chrono::microseconds (200));
+    }
+    return latencies;
+}
+
+template <typename Log, typename Finish>
+static void
+Benchmark (const char *name, const int threads, Log log, Finish finish) {
+    std::vector<std::vector<uint64_t>> results (threads);
+    const uint64_t start = Now ();
+    std::vector<std::thread> workers;
+    for (int thread = 0; thread < threads; thread++)
+        workers.emplace_back ([&, thread] { results[thread] = Burst (log, thread); });
+    for (auto &worker : workers)
+        worker.join ();
+    const uint64_t logged = Now ();
+    finish ();
+    const uint64_t written = Now ();
+
+    std::vector<uint64_t> latencies;
+    for (const auto &result : results)
+        latencies.insert (latencies.end (), result.begin (), result.end ());
+    std::sort (latencies.begin (), latencies.end ());
+    fprintf (stderr, "%-16s %d threads: caller p50 %6.2f us, p99 %7.2f us, max %8.1f us, %zu messages in %7.1f ms, written after %7.1f ms\n", name,
+             threads, latencies[latencies.size () / 2] / 1000.0, latencies[latencies.size () * 99 / 100] / 1000.0, latencies.back () / 1000.0,
+             latencies.size (), (logged - start) / 1e6, (written - start) / 1e6);
+}
+
+int
+main () {
+    const auto directory = std::filesystem::temp_directory_path () / ("logger_bench." + std::to_string (getpid ()));
+    std::filesystem::create_directories (directory);
+    std::filesystem::current_path (directory);
+    if (freopen ("/dev/null", "w", stdout) == nullptr) return 1;
+
+    for (const int threads : {1, 4}) {
+        Old::logLevel = LogLevel::INFO;
+        Old::logFile  = fopen ("old.log", "w");
+        Benchmark (
+            "Old handler", threads, [] (const int thread, const int i) { Old::LogMessage (LogLevel::INFO, "PlaySound called by {} with cue {}", thread, i); },
+            [] { fclose (Old::logFile); });
+
+        InitializeLogger (LogLevel::INFO, true, LogOverflow::Block);
+        Benchmark (
+            "Queued logger", threads, [] (const int thread, const int i) { LogMessage (LogLevel::INFO, "PlaySound called by {} with cue {}", thread, i); },
+            [] { CleanupLogger (); });
+    }
+    std::filesystem::current_path (directory.parent_path ());
+    std::filesystem::remove_all (directory);
+    return 0;
+}
@@ -0,0 +1,81 @@
+#include <chrono>
+#include <cstdio>
+#include <dlfcn.h>
+#include <filesystem>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+/* *
+ * Per-frame cost of calling into plugins, looking exports up by name every frame against the resolved dispatch table.
+ *
+ * The stubs are copied under distinct names so each one is loaded as its own module, like the plugins folder.
+ * Every other plugin only exports Update, so the lookups also pay for missing exports as they did before.
+ * dlsym stands in for GetProcAddress, both search the export table of the module by name.
+ */
+typedef void (*BasicEvent) ();
+typedef bool (*UsingQrEvent) ();
+
+static uint64_t
+Now () {
+    return std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now ().time_since_epoch ()).count ();
+}
+
+constexpr uint64_t Frames = 20000;
+
+// Update of every plugin, then the QR check, as Plugins::Update and Plugins::CheckQr run each frame
+static double
+LookupEveryFrame (const std::vector<void *> &plugins) {
+    const uint64_t start = Now ();
+    for (uint64_t frame = 0; frame < Frames; frame++) {
+        for (void *plugin : plugins)
+            if (auto event = reinterpret_cast<BasicEvent> (dlsym (plugin, "Update"))) event ();
+        for (void *plugin : plugins)
+            if (auto event = reinterpret_cast<UsingQrEvent> (dlsym (plugin, "UsingQr")); event && event ()) break;
+    }
+    return static_cast<double> (Now () - start) / Frames;
+}
+
+static double
+ResolvedTable (const std::vector<void *> &plugins) {
+    std::vector<BasicEvent> updateEvents;
+    std::vector<UsingQrEvent> qrEvents;
+    for (void *plugin : plugins) {
+        if (auto event = reinterpret_cast<BasicEvent> (dlsym (plugin, "Update"))) updateEvents.push_back (event);
+        if (auto event = reinterpret_cast<UsingQrEvent> (dlsym (plugin, "UsingQr"))) qrEvents.push_back (event);
+    }
+    const uint64_t start = Now ();
+    for (uint64_t frame = 0; frame < Frames; frame++) {
+        for (const auto event : updateEvents) event ();
+        for (const auto event : qrEvents)
+            if (event ()) break;
+    }
+    return static_cast<double> (Now () - start) / Frames;
+}
+
+int
+main () {
+    const auto directory = std::filesystem::temp_directory_path () / ("plugin_bench." + std::to_string (getpid ()));
+    std::filesystem::create_directories (directory);
+    std::vector<void *> plugins;
+    for (const size_t count : {10, 25, 50}) {
+        while (plugins.size () < count) {
+            const auto stub = plugins.size () % 2 ? STUB_UPDATE_ONLY_PATH : STUB_PATH;
+            const auto path = directory / ("plugin" + std::to_string (plugins.size ()) + ".so");
+            std::filesystem::copy_file (stub, path, std::filesystem::copy_options::overwrite_existing);
+            void *plugin = dlopen (path.c_str (), RTLD_NOW | RTLD_LOCAL);
+            if (plugin == nullptr) {
+                fprintf (stderr, "Failed to load %s: %s\n", path.c_str (), dlerror ());
+                return 1;
+            }
+            plugins.push_back (plugin);
+        }
+        const double before = LookupEveryFrame (plugins);
+        const double after  = ResolvedTable (plugins);
+        printf ("%2zu plugins: lookup every frame %8.1f ns, resolved table %6.1f ns per frame (%.0fx)\n", count, before, after, before / after);
+    }
+    for (void *plugin : plugins)
+        dlclose (plugin);
+    std::filesystem::remove_all (directory);
+    return 0;
+}
@@ -0,0 +1,19 @@
+#include <cstddef>
+
+// Stand-in plugin for plugin_bench, built once with every per-frame export and once with Update only
+static volatile unsigned long long updates;
+
+extern "C" __attribute__ ((visibility ("default"))) void
+Update () {
+    updates = updates + 1;
+}
+
+#ifndef STUB_UPDATE_ONLY
+extern "C" __attribute__ ((visibility ("default"))) bool
+UsingQr () {
+    return false;
+}
+
+extern "C" __attribute__ ((visibility ("default"))) void
+UpdateStatus (size_t, bool) {}
+#endif
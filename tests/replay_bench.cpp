@@ -0,0 +1,45 @@
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include "replay_game.h"
+
+/* *
+ * Throughput of the input path over a recording: every frame is mapped from the file, loaded into the
+ * poll state, evaluated into logical input and its taps scheduled and delivered, as fast as it goes.
+ */
+static uint64_t
+Now () {
+    return std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now ().time_since_epoch ()).count ();
+}
+
+static void
+Benchmark (const char *path, const uint64_t frames, const uint64_t frameTime, const uint64_t minInterval) {
+    const uint64_t hits = ReplayGame::RecordRoll (path, frames, frameTime, 4, 1);
+    InputReplay replay;
+    if (!replay.Open (path)) {
+        printf ("Could not open %s\n", path);
+        return;
+    }
+
+    ReplayGame::Game game (minInterval);
+    uint64_t delivered   = 0;
+    const uint64_t start = Now ();
+    while (const InputSnapshot *snapshot = replay.Next ())
+        game.Frame (*snapshot, [&] (uint8_t, const DrumHit &) { delivered++; });
+    const uint64_t elapsed = Now () - start;
+    printf ("%llu frames at %4.0f fps, interval %5llu us: %6.1f ns per frame, %llu of %llu hits delivered, %llu dropped\n",
+            static_cast<unsigned long long> (frames), 1000000.0 / static_cast<double> (frameTime), static_cast<unsigned long long> (minInterval),
+            static_cast<double> (elapsed) / static_cast<double> (frames), static_cast<unsigned long long> (delivered),
+            static_cast<unsigned long long> (hits), static_cast<unsigned long long> (game.Dropped ()));
+}
+
+int
+main () {
+    const std::string path = (std::filesystem::temp_directory_path () / "replay_bench.bin").string ();
+    Benchmark (path.c_str (), 200000, 16667, 0);
+    Benchmark (path.c_str (), 200000, 4167, 0);
+    Benchmark (path.c_str (), 200000, 4167, 20000);
+    std::filesystem::remove (path);
+    return 0;
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+#include "bindings.h"
+#include "drum.h"
+#include "input.h"
+#include "replay.h"
+
+/* *
+ * Stand-in for the replay path of bnusio on Linux, used by the replay test and benchmark.
+ *
+ * Each snapshot is loaded like ApplySnapshot, the eight pad bindings are published into a LogicalInputChannel
+ * like PublishLogicalInput, and the pads are polled in order like bnusio_GetAnalogIn on recorded time:
+ * the taps of the frame are queued when pad 0 is read and every pad then takes at most one hit.
+ */
+namespace ReplayGame {
+// Keyboard keys of P1 and P2 left blue, left red, right red and right blue
+constexpr uint8_t PadKeys[8] = {'D', 'F', 'J', 'K', 'Z', 'X', 'N', 'M'};
+
+struct PadBindings {
+    uint8_t keycodes[255];
+    int buttons[255];
+    SDLAxis axis[255];
+    Scroll scroll[2];
+    uint8_t buttonSlots[255];
+    uint8_t axisSlots[255];
+};
+
+class Game {
+public:
+    explicit Game (const uint64_t minInterval) {
+        for (uint8_t pad = 0; pad < std::size (PadKeys); pad++) {
+            PadBindings bindings = {};
+            std::fill (std::begin (bindings.buttons), std::end (bindings.buttons), -1);
+            bindings.keycodes[0] = PadKeys[pad];
+            this->compiled[pad]  = CompileBindings (bindings, 21);
+        }
+        for (HitScheduler &scheduler : this->schedulers)
+            scheduler.Configure (minInterval, 16, DropPolicy::Oldest);
+    }
+
+    // Calls deliver (pad, hit) for every hit the game reads in this frame
+    template <typename Deliver>
+    void
+    Frame (const InputSnapshot &snapshot, Deliver &&deliver) {
+        LoadSnapshot (this->state, snapshot);
+        uint32_t down = 0, tapped = 0, released = 0;
+        for (uint8_t pad = 0; pad < std::size (PadKeys); pad++) {
+            const auto [Down, Released, Tapped] = EvaluateBindings (this->compiled[pad], this->state);
+            down |= static_cast<uint32_t> (Down >= 1.0f) << pad;
+            tapped |= static_cast<uint32_t> (Tapped) << pad;
+            released |= static_cast<uint32_t> (Released) << pad;
+        }
+        this->channel.Publish (down, tapped, released);
+
+        for (uint8_t pad = 0; pad < std::size (PadKeys); pad++) {
+            if (pad == 0) this->taps.Queue (this->channel.Load (), 0, snapshot.timestamp, this->schedulers);
+            if (DrumHit hit{}; this->schedulers[pad / 4].Deliver (pad % 4, snapshot.timestamp, hit)) deliver (pad, hit);
+        }
+    }
+
+    uint64_t Pending () const { return this->schedulers[0].Pending () + this->schedulers[1].Pending (); }
+    uint64_t Dropped () const { return this->schedulers[0].Dropped () + this->schedulers[1].Dropped (); }
+
+private:
+    CompiledBindings compiled[std::size (PadKeys)];
+    InputState state = {};
+    LogicalInputChannel channel;
+    PadTaps taps;
+    HitScheduler schedulers[2];
+};
+
+/* *
+ * Records frames of a roll at a fixed frame time: pad i is hit every period frames, offset by i * spread frames,
+ * and held for one frame. Returns the number of hits in the recording.
+ */
+inline uint64_t
+RecordRoll (const char *path, const uint64_t frames, const uint64_t frameTime, const uint64_t period, const uint64_t spread) {
+    std::remove (path);
+    InputRecorder recorder;
+    if (!recorder.Open (path)) return 0;
+    uint64_t hits = 0;
+    for (uint64_t frame = 0; frame < frames; frame++) {
+        InputSnapshot snapshot{};
+        snapshot.timestamp = (frame + 1) * frameTime;
+        for (uint8_t pad = 0; pad < std::size (PadKeys); pad++) {
+            if ((frame + pad * spread) % period != 0) continue;
+            snapshot.keyboard[PadKeys[pad] / 64] |= 1ull << (PadKeys[pad] % 64);
+            hits++;
+        }
+        recorder.Write (snapshot);
+    }
+    recorder.Close ();
+    return hits;
+}
+} // namespace ReplayGame
@@ -0,0 +1,112 @@
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "check.h"
+#include "replay_game.h"
+
+/* *
+ * Hit scheduling regression over recorded input: a roll is recorded, then replayed through
+ * ReplayGame at full speed on recorded time and the delivered hits are checked frame by frame.
+ */
+static const std::string path = (std::filesystem::temp_directory_path () / "replay_test.bin").string ();
+
+struct Delivery {
+    uint64_t frame;
+    uint8_t pad;
+    uint64_t timestamp;
+
+    bool operator== (const Delivery &) const = default;
+};
+
+struct Replayed {
+    std::vector<Delivery> deliveries;
+    uint64_t pending;
+    uint64_t dropped;
+};
+
+static Replayed
+Replay (const uint64_t minInterval) {
+    Replayed replayed{};
+    InputReplay replay;
+    CHECK (replay.Open (path.c_str ()));
+    ReplayGame::Game game (minInterval);
+    for (uint64_t frame = 0; const InputSnapshot *snapshot = replay.Next (); frame++)
+        game.Frame (*snapshot, [&] (const uint8_t pad, const DrumHit &hit) { replayed.deliveries.push_back ({frame, pad, hit.timestamp}); });
+    replayed.pending = game.Pending ();
+    replayed.dropped = game.Dropped ();
+    return replayed;
+}
+
+static void
+RecordingRoundTrip () {
+    constexpr uint64_t FrameTime = 16667;
+    const uint64_t hits          = ReplayGame::RecordRoll (path.c_str (), 100, FrameTime, 10, 1);
+    CHECK_EQ (hits, 80u);
+
+    InputReplay replay;
+    CHECK (replay.Open (path.c_str ()));
+    CHECK_EQ (replay.Count (), 100u);
+    for (uint64_t frame = 0; const InputSnapshot *snapshot = replay.Next (); frame++) {
+        CHECK_EQ (snapshot->timestamp, (frame + 1) * FrameTime);
+        // Pad 0 is hit on every tenth frame
+        CHECK_EQ ((snapshot->keyboard['D' / 64] >> ('D' % 64) & 1) != 0, frame % 10 == 0);
+    }
+    CHECK (replay.Next () == nullptr);
+}
+
+// Without a minimum interval every tap reaches the game in the frame it was recorded in, at its recorded time
+static void
+EveryTapIsDeliveredInItsFrame () {
+    constexpr uint64_t FrameTime = 16667;
+    // Every pad of a player is hit in the same frame now and then
+    const uint64_t hits    = ReplayGame::RecordRoll (path.c_str (), 600, FrameTime, 6, 3);
+    const Replayed replayed = Replay (0);
+    CHECK_EQ (replayed.deliveries.size (), hits);
+    CHECK_EQ (replayed.dropped, 0u);
+    CHECK_EQ (replayed.pending, 0u);
+    for (const auto &[frame, pad, timestamp] : replayed.deliveries) {
+        CHECK_EQ (timestamp, (frame + 1) * FrameTime);
+        CHECK_EQ ((frame + pad * 3) % 6, 0u);
+    }
+}
+
+// A roll faster than the interval at 240 frames per second is spaced out, only the backlog overflow is lost
+static void
+MinimumIntervalHoldsAtFullSpeed () {
+    constexpr uint64_t FrameTime   = 4167;
+    constexpr uint64_t MinInterval = 20000;
+    const uint64_t hits            = ReplayGame::RecordRoll (path.c_str (), 2400, FrameTime, 8, 1);
+    const Replayed replayed        = Replay (MinInterval);
+    CHECK_EQ (replayed.deliveries.size () + replayed.pending + replayed.dropped, hits);
+    CHECK (replayed.dropped > 0);
+
+    uint64_t lastDelivery[2] = {};
+    bool delivered[2]        = {};
+    for (const auto &[frame, pad, timestamp] : replayed.deliveries) {
+        const uint64_t now = (frame + 1) * FrameTime;
+        CHECK (timestamp <= now);
+        if (delivered[pad / 4]) CHECK (now - lastDelivery[pad / 4] >= MinInterval);
+        lastDelivery[pad / 4] = now;
+        delivered[pad / 4]    = true;
+    }
+}
+
+static void
+ReplayIsDeterministic () {
+    ReplayGame::RecordRoll (path.c_str (), 1200, 8333, 5, 2);
+    const Replayed first  = Replay (12000);
+    const Replayed second = Replay (12000);
+    CHECK (!first.deliveries.empty ());
+    CHECK (first.deliveries == second.deliveries);
+    CHECK_EQ (first.dropped, second.dropped);
+}
+
+int
+main () {
+    RecordingRoundTrip ();
+    EveryTapIsDeliveredInItsFrame ();
+    MinimumIntervalHoldsAtFullSpeed ();
+    ReplayIsDeterministic ();
+    std::filesystem::remove (path);
+    return TEST_RESULT ();
+}
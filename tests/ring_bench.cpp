@@ -0,0 +1,55 @@
+#include <chrono>
+#include <cstdio>
+#include <queue>
+#include "ring.h"
+
+/* *
+ * Push and pop throughput of the rings against the std::queue the button queues used to be.
+ *
+ * Every round pushes a burst like a drum roll between two polls and pops all of it.
+ */
+static uint64_t
+Now () {
+    return std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now ().time_since_epoch ()).count ();
+}
+
+// Keeps the compiler from dropping the popped values
+static volatile uint64_t sink;
+
+template <typename Push, typename Pop>
+static void
+Benchmark (const char *name, const size_t burst, Push push, Pop pop) {
+    constexpr size_t Items = 50000000;
+    uint64_t sum          = 0;
+    const uint64_t start  = Now ();
+    for (size_t i = 0; i < Items; i += burst) {
+        for (size_t j = 0; j < burst; j++)
+            push (static_cast<uint8_t> (i + j));
+        uint8_t value;
+        while (pop (value))
+            sum += value;
+    }
+    sink = sum;
+    printf ("%-22s burst %3zu: %5.2f ns per push and pop\n", name, burst, static_cast<double> (Now () - start) / Items);
+}
+
+int
+main () {
+    for (const size_t burst : {1, 8, 64}) {
+        std::queue<uint8_t> queue;
+        Benchmark ("std::queue<uint8_t>", burst, [&] (const uint8_t value) { queue.push (value); }, [&] (uint8_t &value) {
+            if (queue.empty ()) return false;
+            value = queue.front ();
+            queue.pop ();
+            return true;
+        });
+
+        static FixedRing<uint8_t, 256> fixed;
+        Benchmark (
+            "FixedRing<uint8_t>", burst, [&] (const uint8_t value) { fixed.Push (value); }, [&] (uint8_t &value) { return fixed.Pop (value); });
+
+        static SpscRing<uint8_t, 256> spsc;
+        Benchmark ("SpscRing<uint8_t>", burst, [&] (const uint8_t value) { spsc.Push (value); }, [&] (uint8_t &value) { return spsc.Pop (value); });
+    }
+    return 0;
+}
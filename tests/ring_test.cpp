@@ -0,0 +1,105 @@
+#include <cstdlib>
+#include <new>
+#include "check.h"
+#include "drum.h"
+#include "ring.h"
+
+// Every allocation of the test binary is counted, so a loop can prove it never allocates
+static size_t allocations = 0;
+
+void *
+operator new (const size_t size) {
+    allocations++;
+    if (void *memory = malloc (size == 0 ? 1 : size)) return memory;
+    throw std::bad_alloc ();
+}
+void operator delete (void *memory) noexcept { free (memory); }
+void operator delete (void *memory, size_t) noexcept { free (memory); }
+
+static void
+FixedRingWrapsAround () {
+    FixedRing<int, 4> ring;
+    for (int round = 0; round < 10; round++) {
+        CHECK (ring.Push (round * 2));
+        CHECK (ring.Push (round * 2 + 1));
+        CHECK_EQ (ring.Front (), round * 2);
+        CHECK_EQ (ring.Back (), round * 2 + 1);
+        int value = 0;
+        CHECK (ring.Pop (value));
+        CHECK_EQ (value, round * 2);
+        CHECK (ring.Pop (value));
+        CHECK_EQ (value, round * 2 + 1);
+    }
+    CHECK (ring.Empty ());
+    CHECK (!ring.Pop ());
+}
+
+static void
+FixedRingCountsOverflows () {
+    FixedRing<int, 8> ring;
+    ring.SetCapacity (3);
+    CHECK_EQ (ring.Capacity (), 3u);
+    for (int i = 0; i < 5; i++)
+        ring.Push (i);
+    CHECK_EQ (ring.Size (), 3u);
+    CHECK_EQ (ring.Overflows (), 2u);
+    CHECK_EQ (ring.Back (), 2);
+
+    // Overwriting keeps the newest items instead
+    ring.PushOverwrite (5);
+    CHECK_EQ (ring.Overflows (), 3u);
+    CHECK_EQ (ring.Front (), 1);
+    CHECK_EQ (ring.Back (), 5);
+}
+
+static void
+FixedRingClampsCapacity () {
+    FixedRing<int, 8> ring;
+    ring.SetCapacity (0);
+    CHECK_EQ (ring.Capacity (), 1u);
+    ring.SetCapacity (100);
+    CHECK_EQ (ring.Capacity (), 8u);
+}
+
+static void
+SpscRingIsBounded () {
+    SpscRing<int, 4> ring;
+    for (int i = 0; i < 4; i++)
+        CHECK (ring.Push (i));
+    CHECK (!ring.Push (4));
+    CHECK_EQ (ring.Size (), 4u);
+    int value = 0;
+    for (int i = 0; i < 4; i++) {
+        CHECK (ring.Pop (value));
+        CHECK_EQ (value, i);
+    }
+    CHECK (!ring.Pop (value));
+    CHECK (ring.Empty ());
+}
+
+// Fast rolls through a full backlog, the drum input path must not allocate once configured
+static void
+SteadyStatePollingDoesNotAllocate () {
+    static HitScheduler scheduler;
+    scheduler.Configure (0, 16, DropPolicy::Oldest);
+    const size_t before = allocations;
+    DrumHit hit{};
+    for (uint64_t frame = 0; frame < 100000; frame++) {
+        for (uint8_t i = 0; i < 8; i++)
+            scheduler.Push ({frame * 16667 + i, static_cast<uint8_t> (i % 4)});
+        for (uint8_t pad = 0; pad < 4; pad++)
+            scheduler.Deliver (pad, frame * 16667, hit);
+    }
+    CHECK_EQ (allocations - before, 0u);
+    CHECK (scheduler.Dropped () > 0);
+}
+
+int
+main () {
+    FixedRingWrapsAround ();
+    FixedRingCountsOverflows ();
+    FixedRingClampsCapacity ();
+    SpscRingIsBounded ();
+    SteadyStatePollingDoesNotAllocate ();
+    return TEST_RESULT ();
+}
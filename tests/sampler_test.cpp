@@ -0,0 +1,92 @@
+#include <thread>
+#include "check.h"
+#include "sampler.h"
+
+// Pad bits returned by the synthetic source on the next sample
+static uint8_t padState = 0;
+
+static void
+StateChangesBecomeEvents () {
+    padState = 0;
+    InputSampler sampler ([] { return padState; });
+    DrumEvent event{};
+
+    sampler.SampleOnce (100);
+    CHECK (!sampler.Pop (event));
+
+    padState = 0b1001;
+    sampler.SampleOnce (200);
+    CHECK (sampler.Pop (event));
+    CHECK_EQ (event.pad, 0);
+    CHECK (event.pressed);
+    CHECK_EQ (event.timestamp, 200u);
+    CHECK (sampler.Pop (event));
+    CHECK_EQ (event.pad, 3);
+    CHECK (!sampler.Pop (event));
+
+    // Held pads do not repeat
+    sampler.SampleOnce (300);
+    CHECK (!sampler.Pop (event));
+
+    padState = 0b1000;
+    sampler.SampleOnce (400);
+    CHECK (sampler.Pop (event));
+    CHECK_EQ (event.pad, 0);
+    CHECK (!event.pressed);
+    CHECK_EQ (event.timestamp, 400u);
+}
+
+// A consumer that stops popping loses events, the sampler counts them instead of blocking
+static void
+FullRingDropsEvents () {
+    padState = 0;
+    InputSampler sampler ([] { return padState; });
+    for (uint64_t i = 0; i < 1024 + 10; i++) {
+        padState ^= 1;
+        sampler.SampleOnce (i);
+    }
+    CHECK_EQ (sampler.Dropped (), 10u);
+
+    DrumEvent event{};
+    uint64_t popped = 0;
+    while (sampler.Pop (event))
+        CHECK_EQ (event.timestamp, popped++);
+    CHECK_EQ (popped, 1024u);
+}
+
+// Every tap of the source thread arrives in order on the consumer side
+static void
+ThreadedSampling () {
+    static std::atomic<uint32_t> samples{0};
+    samples = 0;
+    InputSampler sampler ([] { return static_cast<uint8_t> (samples.fetch_add (1) & 1); });
+    sampler.Start (2000);
+    CHECK (sampler.Running ());
+
+    uint64_t events = 0, lastTimestamp = 0;
+    bool pressed = false, ordered = true;
+    DrumEvent event{};
+    const auto deadline = std::chrono::steady_clock::now () + std::chrono::seconds (5);
+    while (events < 100 && std::chrono::steady_clock::now () < deadline) {
+        if (!sampler.Pop (event)) {
+            std::this_thread::sleep_for (std::chrono::milliseconds (1));
+            continue;
+        }
+        ordered       = ordered && event.pressed != pressed && event.timestamp >= lastTimestamp;
+        pressed       = event.pressed;
+        lastTimestamp = event.timestamp;
+        events++;
+    }
+    sampler.Stop ();
+    CHECK (!sampler.Running ());
+    CHECK_EQ (events, 100u);
+    CHECK (ordered);
+}
+
+int
+main () {
+    StateChangesBecomeEvents ();
+    FullRingDropsEvents ();
+    ThreadedSampling ();
+    return TEST_RESULT ();
+}
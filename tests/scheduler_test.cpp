@@ -0,0 +1,165 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "check.h"
+#include "scheduler.h"
+
+// Fake clock in microseconds, only moves when a test advances it
+static std::atomic<uint64_t> now{0};
+
+static uint64_t
+FakeClock () {
+    return now.load ();
+}
+
+static void
+WaitUntil (const std::atomic<bool> &flag, const bool value) {
+    while (flag.load () != value) std::this_thread::sleep_for (std::chrono::milliseconds (1));
+}
+
+// Several call sites of the same frame only run a task once
+static void
+TasksRunAtMostOncePerFrame () {
+    now = 0;
+    FrameScheduler scheduler (FakeClock);
+    int pre = 0, post = 0;
+    scheduler.Add ("pre", TaskPhase::PrePresent, 0, [&] { pre++; });
+    scheduler.Add ("post", TaskPhase::PostPresent, 0, [&] { post++; });
+
+    CHECK (scheduler.BeginFrame ());
+    scheduler.Run (TaskPhase::PrePresent);
+    scheduler.Run (TaskPhase::PrePresent);
+    CHECK_EQ (pre, 1);
+    CHECK_EQ (post, 0);
+    scheduler.Run (TaskPhase::PostPresent);
+    scheduler.Run (TaskPhase::PostPresent);
+    CHECK_EQ (post, 1);
+
+    CHECK (scheduler.BeginFrame ());
+    scheduler.Run (TaskPhase::PrePresent);
+    CHECK_EQ (pre, 2);
+    CHECK_EQ (scheduler.Frame (), 2u);
+}
+
+static void
+FrameIntervalSkipsEarlyFrames () {
+    now = 0;
+    FrameScheduler scheduler (FakeClock);
+    scheduler.SetFrameInterval (16000);
+    CHECK (scheduler.BeginFrame ());
+    now = 5000;
+    CHECK (!scheduler.BeginFrame ());
+    now = 15999;
+    CHECK (!scheduler.BeginFrame ());
+    now = 16000;
+    CHECK (scheduler.BeginFrame ());
+    CHECK_EQ (scheduler.Frame (), 2u);
+}
+
+// Periodic tasks only run with the post-present pass, once their period elapsed
+static void
+PeriodicTasksFollowTheirPeriod () {
+    now = 0;
+    FrameScheduler scheduler (FakeClock);
+    int runs = 0;
+    scheduler.Add ("periodic", TaskPhase::Periodic, 0, [&] { runs++; }, 100000);
+
+    for (uint64_t frame = 0; frame < 60; frame++) {
+        now = frame * 16667;
+        scheduler.BeginFrame ();
+        scheduler.Run (TaskPhase::PrePresent);
+        scheduler.Run (TaskPhase::PostPresent);
+    }
+    // At 60 frames per second every sixth frame is 100000 past the last run, up to the one at 983353
+    CHECK_EQ (runs, 9);
+}
+
+static void
+OverrunsAreCounted () {
+    now = 0;
+    FrameScheduler scheduler (FakeClock);
+    uint64_t cost = 1000;
+    auto &task    = scheduler.Add ("slow", TaskPhase::PrePresent, 2000, [&] { now += cost; });
+    for (int frame = 0; frame < 4; frame++) {
+        if (frame == 2) cost = 3000;
+        scheduler.BeginFrame ();
+        scheduler.Run (TaskPhase::PrePresent);
+    }
+    CHECK_EQ (task.runs.load (), 4u);
+    CHECK_EQ (task.overruns.load (), 2u);
+    CHECK_EQ (task.lastDuration.load (), 3000u);
+}
+
+// A worker task still running is skipped on later frames and reported once as stalled
+static void
+BusyWorkerTasksAreSkipped () {
+    now = 0;
+    FrameScheduler scheduler (FakeClock);
+    std::atomic<bool> release{false}, started{false};
+    int stalls = 0;
+    scheduler.SetStallHandler ([&] (const FrameScheduler::Task &) { stalls++; });
+    auto &task = scheduler.Add (
+        "worker", TaskPhase::PostPresent, 20000,
+        [&] {
+            started = true;
+            WaitUntil (release, true);
+        },
+        0, true);
+
+    scheduler.BeginFrame ();
+    scheduler.Run (TaskPhase::PostPresent);
+    WaitUntil (started, true);
+    for (int frame = 0; frame < 3; frame++) {
+        now += 16667;
+        scheduler.BeginFrame ();
+        scheduler.Run (TaskPhase::PostPresent);
+    }
+    CHECK_EQ (task.skipped.load (), 3u);
+    CHECK_EQ (task.stalls.load (), 1u);
+    CHECK_EQ (stalls, 1);
+
+    release = true;
+    WaitUntil (task.busy, false);
+    scheduler.BeginFrame ();
+    scheduler.Run (TaskPhase::PostPresent);
+    WaitUntil (task.busy, false);
+    CHECK_EQ (task.runs.load (), 2u);
+    CHECK (scheduler.Stop (UINT64_MAX).empty ());
+}
+
+// Stop gives up on a worker stuck in its task and reports it
+static void
+StopAbandonsStuckWorkers () {
+    now = 0;
+    // Outlives the test, the abandoned worker still uses it once it returns
+    static FrameScheduler scheduler (FakeClock);
+    static std::atomic<bool> release{false}, started{false};
+    auto &task = scheduler.Add (
+        "stuck", TaskPhase::PostPresent, 0,
+        [] {
+            started = true;
+            WaitUntil (release, true);
+        },
+        0, true);
+    scheduler.BeginFrame ();
+    scheduler.Run (TaskPhase::PostPresent);
+    WaitUntil (started, true);
+
+    const auto abandoned = scheduler.Stop (50000);
+    CHECK_EQ (abandoned.size (), 1u);
+    if (!abandoned.empty ()) CHECK (abandoned[0] == &task);
+    CHECK (scheduler.Stop (0).empty ());
+    release = true;
+    WaitUntil (task.busy, false);
+}
+
+int
+main () {
+    TasksRunAtMostOncePerFrame ();
+    FrameIntervalSkipsEarlyFrames ();
+    PeriodicTasksFollowTheirPeriod ();
+    OverrunsAreCounted ();
+    BusyWorkerTasksAreSkipped ();
+    StopAbandonsStuckWorkers ();
+    return TEST_RESULT ();
+}
@@ -0,0 +1,173 @@
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include "check.h"
+#include "usio.h"
+
+// Mirrors the file layout of usio.cpp, a header of 16 bytes followed by two slots
+constexpr size_t HeaderSize = 16;
+constexpr size_t SlotSize   = 16 + sizeof (UsioState);
+
+static const std::string path = (std::filesystem::temp_directory_path () / "usio_test.bin").string ();
+
+static void
+Commit (UsioStore &store, const uint32_t coins) {
+    store.Modify ([&] (UsioState &state) { state.coins = coins; });
+    store.Flush ();
+}
+
+static uint32_t
+Coins (UsioStore &store) {
+    return store.Read ([] (const UsioState &state) { return state.coins; });
+}
+
+// Flips one byte of the state in a slot, like a crash in the middle of committing it
+static void
+TearSlot (const int slot) {
+    FILE *file = fopen (path.c_str (), "r+b");
+    CHECK (file != nullptr);
+    if (file == nullptr) return;
+    fseek (file, static_cast<long> (HeaderSize + slot * SlotSize + 16 + 100), SEEK_SET);
+    const int byte = fgetc (file);
+    fseek (file, -1, SEEK_CUR);
+    fputc (byte ^ 0xFF, file);
+    fclose (file);
+}
+
+static void
+StateSurvivesReopen () {
+    std::filesystem::remove (path);
+    UsioStore store;
+    CHECK (store.Open (path.c_str ()));
+    CHECK_EQ (store.Generation (), 0u);
+    CHECK_EQ (Coins (store), 0u);
+    Commit (store, 5);
+    CHECK_EQ (store.Commits (), 1u);
+    store.Close ();
+
+    CHECK (store.Open (path.c_str ()));
+    CHECK_EQ (store.Generation (), 1u);
+    CHECK_EQ (Coins (store), 5u);
+}
+
+// Nothing written since the last flush, nothing to commit
+static void
+CleanFlushDoesNotCommit () {
+    std::filesystem::remove (path);
+    UsioStore store;
+    CHECK (store.Open (path.c_str ()));
+    store.Flush ();
+    CHECK_EQ (store.Commits (), 0u);
+    // Several writes between two flushes coalesce into one commit
+    store.Modify ([] (UsioState &state) { state.coins++; });
+    store.Modify ([] (UsioState &state) { state.services++; });
+    store.Flush ();
+    store.Flush ();
+    CHECK_EQ (store.Commits (), 1u);
+}
+
+static void
+NewestGenerationWins () {
+    std::filesystem::remove (path);
+    UsioStore store;
+    CHECK (store.Open (path.c_str ()));
+    for (uint32_t coins = 1; coins <= 5; coins++)
+        Commit (store, coins);
+    store.Close ();
+
+    CHECK (store.Open (path.c_str ()));
+    CHECK_EQ (store.Generation (), 5u);
+    CHECK_EQ (Coins (store), 5u);
+}
+
+static void
+TornSlotFallsBack () {
+    std::filesystem::remove (path);
+    UsioStore store;
+    CHECK (store.Open (path.c_str ()));
+    for (uint32_t coins = 1; coins <= 3; coins++)
+        Commit (store, coins);
+    store.Close ();
+    // Generation 3 went to slot 1, generation 2 is still complete in slot 0
+    TearSlot (1);
+
+    CHECK (store.Open (path.c_str ()));
+    CHECK_EQ (store.Generation (), 2u);
+    CHECK_EQ (Coins (store), 2u);
+
+    // The next commit overwrites the torn slot and keeps generation 2 as the fallback
+    Commit (store, 7);
+    CHECK_EQ (store.Generation (), 3u);
+    store.Close ();
+    TearSlot (1);
+    CHECK (store.Open (path.c_str ()));
+    CHECK_EQ (Coins (store), 2u);
+}
+
+static void
+BothSlotsTornStartsEmpty () {
+    std::filesystem::remove (path);
+    UsioStore store;
+    CHECK (store.Open (path.c_str ()));
+    Commit (store, 1);
+    Commit (store, 2);
+    store.Close ();
+    TearSlot (0);
+    TearSlot (1);
+
+    CHECK (store.Open (path.c_str ()));
+    CHECK_EQ (store.Generation (), 0u);
+    CHECK_EQ (Coins (store), 0u);
+}
+
+static void
+ForeignFileIsRejected () {
+    FILE *file = fopen (path.c_str (), "wb");
+    CHECK (file != nullptr);
+    if (file != nullptr) {
+        fputs ("not a usio store", file);
+        fclose (file);
+    }
+    UsioStore store;
+    CHECK (!store.Open (path.c_str ()));
+    CHECK (!store.IsOpen ());
+    // The file is left exactly as it was, not grown to the size of a store
+    CHECK_EQ (std::filesystem::file_size (path), 16u);
+}
+
+// A foreign file of at least the size of a store is not overwritten either
+static void
+LargeForeignFileIsUntouched () {
+    const std::string contents (HeaderSize + 2 * SlotSize + 100, 'x');
+    FILE *file = fopen (path.c_str (), "wb");
+    CHECK (file != nullptr);
+    if (file != nullptr) {
+        fwrite (contents.data (), 1, contents.size (), file);
+        fclose (file);
+    }
+    UsioStore store;
+    CHECK (!store.Open (path.c_str ()));
+    store.Close ();
+
+    std::string read (contents.size () + 1, '\0');
+    file = fopen (path.c_str (), "rb");
+    CHECK (file != nullptr);
+    if (file == nullptr) return;
+    CHECK_EQ (fread (read.data (), 1, read.size (), file), contents.size ());
+    fclose (file);
+    read.resize (contents.size ());
+    CHECK (read == contents);
+}
+
+int
+main () {
+    StateSurvivesReopen ();
+    CleanFlushDoesNotCommit ();
+    NewestGenerationWins ();
+    TornSlotFallsBack ();
+    BothSlotsTornStartsEmpty ();
+    ForeignFileIsRejected ();
+    LargeForeignFileIsUntouched ();
+    std::filesystem::remove (path);
+    return TEST_RESULT ();
+}